@@ -1,5 +1,6 @@
 #ifndef CONFIG_H
 #define CONFIG_H
+#include <cstdint>
 
 
 /*
@@ -30,8 +31,40 @@ inline constexpr uint16_t SERIAL_NUMBER = 0;
 #define PORT_DIR_BASE (16)
 
 
+// Tasks the firmware can schedule. Set at build time with
+// -DMAX_TASK_COUNT=<n> (at least 8). The register map grows to match.
+#ifndef MAX_TASK_COUNT
 #define MAX_TASK_COUNT (8)
+#endif
 
-inline constexpr uint8_t MAX_QUEUE_SIZE = 32;
+// Longest frame the task schedule can run (10s, i.e: 0.1Hz).
+#define MAX_FRAME_PERIOD_US (10'000'000)
+
+// Most frames the task schedule can run before it repeats, i.e: the largest
+// common multiple of the task frame divisors.
+#define MAX_CYCLE_FRAME_COUNT (8)
+
+// Furthest ahead a scheduled start can be (10 minutes). core1 compares
+// 32-bit microsecond times, which wrap after ~71 minutes.
+#define MAX_SCHEDULED_START_LEAD_US (600'000'000)
+
+// While a scheduled start is pending, the longest core1 goes without applying
+// core0's commands (i.e: a disable), and how early it wakes up to compile the
+// schedule before the start time.
+#define SCHEDULED_START_POLL_US (100)
+#define SCHEDULED_START_SETUP_US (1'000)
+
+// Time from a trigger input edge to the start of the frame it triggers: long
+// enough for every backend to wake up and start the frame on time, so that
+// the latency is the same for every frame.
+#define TRIGGER_START_DELAY_US (5)
+
+// Longest time from core0 ringing the abort doorbell to every core1 output
+// being LOW.
+#define MAX_ABORT_LATENCY_US (2)
+
+// Hardware alarm that times edges in the timer IRQ schedule backend.
+// (Alarm 3 belongs to the pico-sdk default alarm pool.)
+#define FIP_ALARM_NUM (0)
 
 #endif // CONFIG_H
@@ -2,6 +2,9 @@
 #define CUTTLEFISH_FIP_APP_H
 #include <pico/stdlib.h>
 #include <cstring>
+#include <array>
+#include <algorithm>
+#include <bit>
 #include <config.h>
 #include <harp_message.h>
 #include <harp_core.h>
@@ -10,22 +13,82 @@
 #include <etl/vector.h>
 #include <fip_ctrl_queues.h>
 #include <pico/multicore.h>
+#include <hardware/clocks.h>
 #include <laser_fip_task.h>
+#include <edge_telemetry.h>
+#include <rising_edge_event_batch.h>
+#include <task_table.h>
+#include <fip_timeline.h>
 #ifdef DEBUG
     #include <stdio.h>
     #include <cstdio> // for printf
 #endif
 
 // Setup for Harp App
-inline constexpr uint8_t REG_COUNT = 14;
+// The default register map has settings registers for 8 tasks. Builds with a
+// larger MAX_TASK_COUNT keep the default map as is and append the remaining
+// task settings registers, then the extra LaserTaskTable pages, after it.
+inline constexpr size_t DEFAULT_TASK_REG_COUNT = 8;
+static_assert(MAX_TASK_COUNT >= DEFAULT_TASK_REG_COUNT,
+              "MAX_TASK_COUNT can't be less than the default 8 tasks.");
+inline constexpr size_t EXTRA_TASK_REG_COUNT = MAX_TASK_COUNT - DEFAULT_TASK_REG_COUNT;
+inline constexpr size_t LASER_TASK_TABLE_PAGE_SIZE = 8; // tasks per LaserTaskTable message.
+inline constexpr size_t LASER_TASK_TABLE_PAGE_COUNT
+    = (MAX_TASK_COUNT + LASER_TASK_TABLE_PAGE_SIZE - 1) / LASER_TASK_TABLE_PAGE_SIZE;
+inline constexpr size_t DEFAULT_REG_COUNT = 44;
+static_assert(APP_REG_START_ADDRESS + DEFAULT_REG_COUNT + EXTRA_TASK_REG_COUNT
+              + (LASER_TASK_TABLE_PAGE_COUNT - 1) <= 256,
+              "MAX_TASK_COUNT is too large for 8-bit register addresses.");
+inline constexpr uint8_t REG_COUNT = DEFAULT_REG_COUNT + EXTRA_TASK_REG_COUNT
+                                     + (LASER_TASK_TABLE_PAGE_COUNT - 1);
+inline constexpr size_t IO_PIN_COUNT = 8;
 inline constexpr uint8_t LASER_BASE_ADDRESS = APP_REG_START_ADDRESS + 6;
+inline constexpr uint8_t EXTRA_LASER_BASE_ADDRESS = APP_REG_START_ADDRESS + DEFAULT_REG_COUNT;
+inline constexpr uint8_t EXTRA_LASER_TASK_TABLE_BASE_ADDRESS
+    = EXTRA_LASER_BASE_ADDRESS + EXTRA_TASK_REG_COUNT;
 
-extern etl::vector<LaserFIPTask, MAX_TASK_COUNT> fip_tasks;
-extern RegSpecs app_reg_specs[REG_COUNT];
-extern RegFnPair reg_handler_fns[REG_COUNT];
+extern EdgeTelemetrySnapshot edge_telemetry_snapshot;
+extern TaskTable task_table;
+extern TaskTable edited_task_table;
+/**
+ * \brief the register map. Built on first use rather than as a global: the
+ *  register pointers aren't constant expressions, so a global would be
+ *  initialized at run time, possibly after the app object that reads it.
+ */
+std::array<RegSpecs, REG_COUNT>& app_reg_specs();
+extern std::array<RegFnPair, REG_COUNT> reg_handler_fns;
 extern HarpCApp& app;
 
 #pragma pack(push, 1)
+// One task in the LaserTaskTable register. The same fields as
+// LaserFIPTaskSettings, with the IO pins packed into bytes so that a full
+// table fits in one Harp message.
+struct LaserTaskTableEntry
+{
+    uint8_t pwm_pin_bit; // one-hot encoded IO pin.
+    uint8_t output_mask; // IO pins.
+    uint8_t events;
+    uint8_t mute;
+    float pwm_duty_cycle;
+    float pwm_frequency_hz;
+    uint32_t delta1_us;
+    uint32_t delta2_us;
+    uint32_t delta3_us;
+    uint32_t delta4_us;
+};
+
+// One page (8 tasks) of a schedule. A schedule of up to 8 tasks is written
+// and validated as a unit in one page. Larger builds write a longer schedule
+// as consecutive pages that are validated and applied together.
+struct LaserTaskTableData
+{
+    uint8_t task_count; // tasks in the whole schedule.
+    LaserTaskTableEntry tasks[LASER_TASK_TABLE_PAGE_SIZE]; // entries past task_count are ignored.
+};
+// Largest payload of a timestamped Harp message.
+static_assert(sizeof(LaserTaskTableData) <= 245,
+              "LaserTaskTable must fit in one Harp message.");
+
 struct app_regs_t
 {
     uint8_t EnableTaskSchedule;
@@ -35,6 +98,36 @@ struct app_regs_t
     uint8_t LaserTaskCount;
     uint8_t RisingEdgeEvent;
     LaserFIPTaskSettings ReconfigureLaserTask[MAX_TASK_COUNT];
+    uint32_t EdgeCount;
+    uint32_t EdgeDeadlineMissCount;
+    uint32_t EdgeLatenessMin;
+    uint32_t EdgeLatenessMax;
+    uint32_t EdgeLatenessMeanNs;
+    uint32_t EdgeLatenessHistogram[LATENESS_HISTOGRAM_BUCKET_COUNT];
+    uint8_t ScheduleBackend;
+    uint8_t ActiveScheduleBackend;
+    uint32_t RisingEdgeEventOverflowCount;
+    uint32_t RisingEdgeEventHighWaterMark;
+    uint8_t RisingEdgeEventBatchSize;
+    uint32_t RisingEdgeEventBatch[EventBatch::word_count()];
+    uint32_t TaskSettingsAppliedFrame;
+    LaserTaskTableData LaserTaskTable[LASER_TASK_TABLE_PAGE_COUNT];
+    uint32_t PredictedFramePeriod;
+    float PredictedFrameRate;
+    float PredictedLaserDutyCycle[IO_PIN_COUNT];
+    uint8_t TaskScheduleError;
+    uint32_t FixedFramePeriod;
+    uint32_t FramePeriodSlack;
+    TaskFrameDivisor TaskFrameDivisors[MAX_TASK_COUNT];
+    uint8_t PipelinedExposures;
+    uint32_t AcquisitionFrameCount;
+    uint32_t AcquisitionComplete;
+    uint64_t ScheduledStartTime;
+    uint8_t TriggerMode;
+    uint8_t TriggerPin;
+    uint32_t TriggerLatency[2]; // last, max.
+    uint8_t LaserTaskOrder[MAX_TASK_COUNT]; // task slots in run order, then NO_TASK_SLOT.
+    uint32_t PendingCommandCount;
     // More app "registers" here.
 };
 #pragma pack(pop)
@@ -47,30 +140,80 @@ enum AppRegNum
     RemoveAllLaserTasks = 35,
     LaserTaskCount = 36,
     RisingEdgeEvent = 37,
-    ReconfigureLaserTask0 = 38,
-    ReconfigureLaserTask1 = 39,
-    ReconfigureLaserTask2 = 40,
-    ReconfigureLaserTask3 = 41,
-    ReconfigureLaserTask4 = 42,
-    ReconfigureLaserTask5 = 43,
-    ReconfigureLaserTask6 = 44,
-    ReconfigureLaserTask7 = 45,
-
+    ReconfigureLaserTask0 = 38, // see reconfigure_laser_task_address().
+    EdgeCount = ReconfigureLaserTask0 + DEFAULT_TASK_REG_COUNT,
+    EdgeDeadlineMissCount = 47,
+    EdgeLatenessMin = 48,
+    EdgeLatenessMax = 49,
+    EdgeLatenessMeanNs = 50,
+    EdgeLatenessHistogram = 51,
+    ScheduleBackend = 52,
+    ActiveScheduleBackend = 53,
+    RisingEdgeEventOverflowCount = 54,
+    RisingEdgeEventHighWaterMark = 55,
+    RisingEdgeEventBatchSize = 56,
+    RisingEdgeEventBatch = 57,
+    TaskSettingsAppliedFrame = 58,
+    LaserTaskTable = 59,
+    PredictedFramePeriod = 60,
+    PredictedFrameRate = 61,
+    PredictedLaserDutyCycle = 62,
+    TaskScheduleError = 63,
+    FixedFramePeriod = 64,
+    FramePeriodSlack = 65,
+    TaskFrameDivisors = 66,
+    PipelinedExposures = 67,
+    AcquisitionFrameCount = 68,
+    AcquisitionComplete = 69,
+    ScheduledStartTime = 70,
+    TriggerMode = 71,
+    TriggerPin = 72,
+    TriggerLatency = 73,
+    LaserTaskOrder = 74,
+    PendingCommandCount = 75,
 };
 
 extern app_regs_t app_regs;
 
+/**
+ * \brief address of a task's settings register: the default tasks' follow
+ *  ReconfigureLaserTask0, and the rest follow the last default register.
+ */
+constexpr uint8_t reconfigure_laser_task_address(size_t task_index)
+{
+    if (task_index < DEFAULT_TASK_REG_COUNT)
+        return uint8_t(ReconfigureLaserTask0 + task_index);
+    return uint8_t(EXTRA_LASER_BASE_ADDRESS + (task_index - DEFAULT_TASK_REG_COUNT));
+}
+static_assert(reconfigure_laser_task_address(0) == LASER_BASE_ADDRESS);
+static_assert(APP_REG_START_ADDRESS + DEFAULT_REG_COUNT == PendingCommandCount + 1,
+              "DEFAULT_REG_COUNT must match the default register map.");
+
 /**
  * \brief helper function. Get fip task index from app reg index.
  */
 inline size_t get_fip_task_index(uint8_t address)
-{return address - LASER_BASE_ADDRESS;}
+{
+    if (address < EXTRA_LASER_BASE_ADDRESS)
+        return address - LASER_BASE_ADDRESS;
+    return DEFAULT_TASK_REG_COUNT + (address - EXTRA_LASER_BASE_ADDRESS);
+}
 
 /**
  * \brief helper function. Get fip task index from msg.
  */
 inline size_t get_fip_task_index(msg_t& msg)
-{return msg.header.address - LASER_BASE_ADDRESS;}
+{return get_fip_task_index(msg.header.address);}
+
+/**
+ * \brief helper function. Get LaserTaskTable page from app reg index.
+ */
+inline size_t get_laser_task_table_page(uint8_t address)
+{
+    if (address == AppRegNum::LaserTaskTable)
+        return 0;
+    return 1 + (address - EXTRA_LASER_TASK_TABLE_BASE_ADDRESS);
+}
 
 /**
  * \brief set waveform output to enabled or disabled, but do not destroy tasks.
@@ -79,17 +222,166 @@ inline size_t get_fip_task_index(msg_t& msg)
  */
 bool set_task_schedule_state(bool state);
 
+/**
+ * \brief set one task of a table, resolving its PWM slice registers here on
+ *  core0 so that core1 only writes integers.
+ */
+void set_task_table_entry(TaskTable& table, size_t task_index,
+                          const LaserFIPTaskSettings& settings);
+
+/**
+ * \brief validate edited_task_table and, if the schedule is valid, make it
+ *  the task_table, update the registers that mirror it, and publish it.
+ *  TaskScheduleError holds the result.
+ * \return whether or not the edit was applied.
+ */
+bool commit_task_table_edit();
+
+/**
+ * \brief update the Predicted registers from task_table.
+ */
+void update_schedule_prediction();
+
+/**
+ * \brief hand the edited task_table to core1. If core1 hasn't taken the last
+ *  one yet, it is published from update_app() instead.
+ */
+void publish_task_table();
+
 /**
  * \brief read whether the laser task schedule is enabled or not.
  */
 void read_reconfigure_laser_task(uint8_t address);
 
+/**
+ * \brief read the latest edge timing telemetry published by core1.
+ */
+void read_edge_telemetry(uint8_t address);
+
+/**
+ * \brief read the backend core1 used for the current (or last) session.
+ */
+void read_active_schedule_backend(uint8_t address);
+
+/**
+ * \brief read how many rising edge events core1 dropped because core0 fell
+ *  behind, and the most that were ever waiting at once.
+ */
+void read_rising_edge_event_stats(uint8_t address);
+
+/**
+ * \brief read the latency from a trigger input edge to the first laser edge
+ *  of the frame it started: the last one, and the longest since the schedule
+ *  was enabled.
+ */
+void read_trigger_latency(uint8_t address);
+
+/**
+ * \brief read how many commands core0 has sent core1 (i.e: for register
+ *  writes) that core1 hasn't applied yet.
+ */
+void read_pending_command_count(uint8_t address);
+
+/**
+ * \brief read the frame (counted from when the schedule was enabled) from
+ *  which the last task settings written took effect.
+ */
+void read_task_settings_applied_frame(uint8_t address);
+
+/**
+ * \brief read one LaserTaskTable page of the current tasks.
+ */
+void read_laser_task_table(uint8_t address);
+
 void write_enable_task_schedule(msg_t& msg);
 void write_add_laser_task(msg_t& msg);
 void write_remove_laser_task(msg_t& msg);
 void write_remove_all_laser_tasks(msg_t& msg);
 void write_laser_task_count(msg_t& msg);
 void write_reconfigure_laser_task(msg_t& msg);
+void write_schedule_backend(msg_t& msg);
+void write_rising_edge_event_batch_size(msg_t& msg);
+
+/**
+ * \brief set (or with 0, clear) the fixed frame period. Rejected if the
+ *  current tasks don't fit in it. Takes effect at the next frame boundary.
+ */
+void write_fixed_frame_period(msg_t& msg);
+
+/**
+ * \brief set the frame divisor and phase of every current task. Takes effect
+ *  at the next frame cycle boundary.
+ */
+void write_task_frame_divisors(msg_t& msg);
+
+/**
+ * \brief enable (1) or disable (0) pipelined exposures. Rejected if the
+ *  current tasks wouldn't form a valid schedule. Takes effect at the next
+ *  frame boundary.
+ */
+void write_pipelined_exposures(msg_t& msg);
+
+/**
+ * \brief set the number of frames after which the schedule stops on its own
+ *  (0: run until disabled). Rejected while the schedule runs.
+ */
+void write_acquisition_frame_count(msg_t& msg);
+
+/**
+ * \brief enable the schedule so that its first frame starts at a Harp time
+ *  (us). Rejected while the schedule runs, if the time has passed or is
+ *  more than MAX_SCHEDULED_START_LEAD_US away, or if a finite acquisition
+ *  has no tasks.
+ */
+void write_scheduled_start_time(msg_t& msg);
+
+/**
+ * \brief hand the trigger input settings to core1 and point the IO port's
+ *  bus switch in for the trigger pin (and out for the rest).
+ * \param io_pin_bit one-hot IO pin of the trigger input.
+ * \return false if the queue to core1 is full.
+ */
+bool set_trigger_config(uint8_t mode, uint8_t io_pin_bit);
+
+/**
+ * \brief select what starts the frames (see TriggerMode). Rejected while the
+ *  schedule runs, and triggered modes are rejected until TriggerPin is set.
+ */
+void write_trigger_mode(msg_t& msg);
+
+/**
+ * \brief select the IO pin of the trigger input. Rejected while the schedule
+ *  runs, or if a task uses the pin.
+ */
+void write_trigger_pin(msg_t& msg);
+
+/**
+ * \brief replace every task at once. The table is rejected as a whole if any
+ *  task in it is invalid, and core1 swaps it in as one unit. A table longer
+ *  than one page is staged until its last page is written; its pages must be
+ *  written in order.
+ */
+void write_laser_task_table(msg_t& msg);
+
+/**
+ * \brief send the pending rising edge events as one RisingEdgeEventBatch
+ *  message.
+ */
+void send_rising_edge_event_batch();
+
+/**
+ * \brief send every rising edge event core1 has pushed, one EVENT per edge
+ *  or batched, depending on RisingEdgeEventBatchSize.
+ */
+void send_rising_edge_events();
+
+/**
+ * \brief send an AcquisitionComplete EVENT, timestamped with the end of the
+ *  last frame, for every finite acquisition core1 has ended, after the
+ *  acquisition's rising edge events. Clears EnableTaskSchedule only for the
+ *  acquisition of the last enable sent.
+ */
+void send_acquisition_end_events();
 
 /**
  * \brief update the app state. Called in a loop.
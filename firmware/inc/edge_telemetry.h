@@ -0,0 +1,91 @@
+#ifndef EDGE_TELEMETRY_H
+#define EDGE_TELEMETRY_H
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <bit>
+
+// Lateness buckets: 0us, 1us, 2-3us, 4-7us, ... , >= 64us.
+inline constexpr size_t LATENESS_HISTOGRAM_BUCKET_COUNT = 8;
+// Edges later than this count as deadline misses.
+inline constexpr uint32_t EDGE_DEADLINE_TOLERANCE_US = 1;
+
+/**
+ * \brief lateness statistics of every edge core1 replays in one session.
+ */
+struct EdgeTelemetry
+{
+    uint32_t edge_count;
+    uint32_t deadline_miss_count;
+    uint32_t min_lateness_us;
+    uint32_t max_lateness_us;
+    uint64_t total_lateness_us;
+    uint32_t histogram[LATENESS_HISTOGRAM_BUCKET_COUNT];
+    uint32_t session_start_us; /// first frame's start, which deadlines count from.
+
+    void clear();
+
+/**
+ * \brief record how late (in us) an edge was written after its deadline.
+ */
+    inline void record(uint32_t lateness_us)
+    {
+        ++edge_count;
+        if (lateness_us > EDGE_DEADLINE_TOLERANCE_US)
+            ++deadline_miss_count;
+        if (lateness_us < min_lateness_us)
+            min_lateness_us = lateness_us;
+        if (lateness_us > max_lateness_us)
+            max_lateness_us = lateness_us;
+        total_lateness_us += lateness_us;
+        size_t bucket = std::bit_width(lateness_us);
+        if (bucket >= LATENESS_HISTOGRAM_BUCKET_COUNT)
+            bucket = LATENESS_HISTOGRAM_BUCKET_COUNT - 1;
+        ++histogram[bucket];
+    }
+
+/**
+ * \brief record edges written exactly on their deadlines, i.e: by hardware
+ *  that times them to the clock cycle.
+ */
+    inline void record_on_time(uint32_t count)
+    {
+        if (!count)
+            return;
+        edge_count += count;
+        min_lateness_us = 0;
+        histogram[0] += count;
+    }
+
+/**
+ * \brief mean lateness in nanoseconds.
+ */
+    uint32_t mean_lateness_ns() const;
+};
+
+/**
+ * \brief EdgeTelemetry published by core1 and read by core0.
+ * \details a sequence lock: core1 never waits, and core0 retries a read
+ *  that overlapped a publish.
+ */
+class EdgeTelemetrySnapshot
+{
+public:
+    EdgeTelemetrySnapshot(): sequence_{0}, data_{} {}
+
+/**
+ * \brief copy the latest telemetry in. Only core1 may call this.
+ */
+    void publish(const EdgeTelemetry& telemetry);
+
+/**
+ * \brief copy the latest consistent telemetry out.
+ */
+    void read(EdgeTelemetry& telemetry) const;
+
+private:
+    std::atomic<uint32_t> sequence_; /// odd while a publish is in progress.
+    EdgeTelemetry data_;
+};
+
+#endif // EDGE_TELEMETRY_H
@@ -1,28 +1,169 @@
 #ifndef FIP_CTRL_QUEUES_H
 #define FIP_CTRL_QUEUES_H
-#include <pico/util/queue.h>
+#include <fip_hal.h>
+#include <atomic>
 #include <laser_fip_task.h>
+#include <spsc_ring.h>
+#include <task_table.h>
 
-// Container to unpack laser task index and settings from a received harp message.
-struct ReconfigureTaskData
+// Hardware that generates the FIP outputs.
+enum ScheduleBackend: uint8_t
 {
-    size_t task_index;
-    LaserFIPTaskSettings settings;
+    CPU_BACKEND = 0, // core1 busy-waits for and writes every edge.
+    PIO_BACKEND = 1, // a PIO state machine replays the frame from DMA.
+    TIMER_IRQ_BACKEND = 2, // a timer alarm interrupt writes every edge.
 };
+inline constexpr uint8_t SCHEDULE_BACKEND_COUNT = 3;
 
-// Container to unpack rising edge event info from a received harp message.
+// What starts the FIP frames.
+enum TriggerMode: uint8_t
+{
+    TRIGGER_NONE = 0, // frames run back to back from the enable.
+    TRIGGER_START = 1, // the first frame waits for a trigger input edge.
+    TRIGGER_EACH_FRAME = 2, // every frame waits for a trigger input edge.
+};
+inline constexpr uint8_t TRIGGER_MODE_COUNT = 3;
+
+struct TriggerConfig
+{
+    uint8_t mode; // TriggerMode.
+    uint8_t pin;  // gpio pin of the trigger input.
+};
+
+// What a command from core0 asks core1 to do.
+enum Core1CommandType: uint8_t
+{
+    CMD_ENABLE_SCHEDULE = 0, // value: 1 starts the schedule now, 0 stops it.
+    CMD_START_SCHEDULE_AT = 1, // value: local time (us) of the first frame.
+    CMD_SCHEDULE_BACKEND = 2, // value: ScheduleBackend of the next start.
+    CMD_ACQUISITION_FRAME_COUNT = 3, // value: frames to run. 0: until disabled.
+    CMD_TRIGGER_CONFIG = 4, // trigger_config.
+};
+
+/**
+ * \brief one command from core0 to core1. Core1 applies commands in the
+ *  order core0 sent them, and acknowledges each by its sequence number.
+ * \details core0 only changes the backend, acquisition length and trigger
+ *  while the schedule is disabled.
+ */
+struct Core1Command
+{
+    uint32_t sequence; /// set by send_core1_command().
+    uint8_t type; /// Core1CommandType.
+    TriggerConfig trigger_config; /// CMD_TRIGGER_CONFIG only.
+    uint32_t value; /// every other command.
+
+    static Core1Command enable(bool state)
+    {return {0, CMD_ENABLE_SCHEDULE, {}, state};}
+
+    static Core1Command start_at(uint32_t start_us)
+    {return {0, CMD_START_SCHEDULE_AT, {}, start_us};}
+
+    static Core1Command backend(uint8_t backend)
+    {return {0, CMD_SCHEDULE_BACKEND, {}, backend};}
+
+    static Core1Command acquisition_frame_count(uint32_t frames)
+    {return {0, CMD_ACQUISITION_FRAME_COUNT, {}, frames};}
+
+    static Core1Command trigger(TriggerConfig config)
+    {return {0, CMD_TRIGGER_CONFIG, config, 0};}
+};
+
+// Commands core0 can send before core1 applies any.
+inline constexpr size_t CORE1_COMMAND_QUEUE_SIZE = 32;
+
+// Rising edge event from core1. Timestamps are the lower 32 bits of the
+// microsecond timer; core0 recovers the full time with unwrap_time_us().
 struct RisingEdgeEventData
 {
     uint32_t output_state;
-    uint64_t time_us;
+    uint32_t time_us;
 };
 
-// Queues for multicore communication.
-extern queue_t enable_task_schedule_queue;
-extern queue_t add_task_queue;
-extern queue_t remove_task_queue;
-extern queue_t clear_tasks_queue;
-extern queue_t reconfigure_task_queue;
-extern queue_t rising_edge_event_queue;
+inline constexpr size_t RISING_EDGE_EVENT_RING_SIZE = 64;
+using RisingEdgeEventRing = SPSCRing<RisingEdgeEventData, RISING_EDGE_EVENT_RING_SIZE>;
+
+/**
+ * \brief recover a 64-bit timestamp from its lower 32 bits, given that it is
+ *  in the past but no more than 2^32 us (~71 minutes) older than now_us.
+ */
+inline uint64_t unwrap_time_us(uint32_t time_us, uint64_t now_us)
+{return now_us - uint32_t(uint32_t(now_us) - time_us);}
+
+// End of a finite acquisition, from core1 to core0.
+struct AcquisitionEndData
+{
+    uint32_t frame_count;   // frames acquired.
+    uint32_t time_us;       // end of the last frame, like RisingEdgeEventData.
+    uint32_t enable_sequence; // last enable command applied while it ran.
+};
+
+inline constexpr size_t ACQUISITION_END_RING_SIZE = 4;
+using AcquisitionEndRing = SPSCRing<AcquisitionEndData, ACQUISITION_END_RING_SIZE>;
+
+// Commands from core0 to core1, in order (Core1Command).
+extern queue_t core1_command_queue;
+
+// Sequence number of the last command core1 applied.
+extern std::atomic<uint32_t> core1_command_ack;
+
+// Sequence number of the last command core0 sent. Core0 only.
+inline uint32_t core1_command_sequence = 0;
+
+/**
+ * \brief (core0) number command and queue it for core1.
+ * \return false if the queue is full. Nothing is sent.
+ */
+inline bool send_core1_command(Core1Command command)
+{
+    command.sequence = core1_command_sequence + 1;
+    if (!queue_try_add(&core1_command_queue, &command))
+        return false;
+    core1_command_sequence = command.sequence;
+    return true;
+}
+
+/**
+ * \brief (core0) number of commands sent that core1 hasn't applied yet.
+ */
+inline uint32_t core1_pending_command_count()
+{
+    return core1_command_sequence
+           - core1_command_ack.load(std::memory_order_acquire);
+}
+
+/**
+ * \brief (core0) true once core1 has applied every command sent so far.
+ */
+inline bool core1_commands_applied()
+{return core1_pending_command_count() == 0;}
+
+/**
+ * \brief (core0) stop core1's outputs mid-frame and disable the schedule.
+ * \details only rings the doorbell, so it works even with the command queue
+ *  full. The doorbell carries the sequence number of the next command core0
+ *  sends: core1 aborts before it applies that command, and skips the enables
+ *  sent before the ring, so a command written after the abort (i.e: a new
+ *  enable) is never undone by a doorbell core1 noticed late.
+ */
+inline void send_core1_abort()
+{hal_doorbell_ring(core1_command_sequence + 1);}
+
+// Rising edge events from core1 to core0.
+extern RisingEdgeEventRing rising_edge_event_ring;
+
+// Ends of finite acquisitions from core1 to core0.
+extern AcquisitionEndRing acquisition_end_ring;
+
+// Task settings from core0 to core1.
+extern TaskTableSwap task_table_swap;
+
+// Backend core1 used for the current (or last) session.
+extern std::atomic<uint8_t> active_schedule_backend;
+
+// Time (us) from a trigger input edge to the first laser edge of the frame
+// it started: for the last triggered frame, and the longest of the session.
+extern std::atomic<uint32_t> trigger_latency_us;
+extern std::atomic<uint32_t> max_trigger_latency_us;
 
-#endif // SCHEDULE_CTRL_QUEUES_H
+#endif // FIP_CTRL_QUEUES_H
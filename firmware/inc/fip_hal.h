@@ -0,0 +1,244 @@
+#ifndef FIP_HAL_H
+#define FIP_HAL_H
+#include <cstdint>
+
+/**
+ * Thin hardware abstraction layer for everything the core1 FIP scheduler
+ * touches: the timer and its alarm, GPIO outputs, laser PWM, the trigger
+ * input, the abort doorbell, and the inter-core queues.
+ *
+ * Firmware builds map each function directly onto the pico-sdk, so there is
+ * no runtime cost. Host builds (FIP_HOST_BUILD, see tests/host) link the same
+ * scheduler sources against a simulated clock and a recording GPIO/PWM
+ * backend instead.
+ *
+ * Inter-core queues keep the pico-sdk queue_t interface. The host backend
+ * provides a compatible queue_t.
+ */
+#if defined(FIP_HOST_BUILD)
+#include <sim_hal.h>
+#else
+#include <atomic>
+#include <pico/stdlib.h>
+#include <pico/util/queue.h>
+#include <hardware/structs/timer.h>
+#include <hardware/timer.h>
+#include <hardware/irq.h>
+#include <hardware/sync.h>
+#include <hardware/gpio.h>
+#include <hardware/clocks.h>
+#include <hardware/pwm.h>
+#include <config.h>
+
+/**
+ * \brief fast read of the lower 32 bits of the microsecond timer.
+ */
+inline uint32_t hal_time_us_32()
+{return timer_hw->timerawl;}
+
+/**
+ * \brief read the full 64-bit microsecond timer.
+ * \warning this fn should not be called inside an interrupt.
+ */
+inline uint64_t hal_time_us_64()
+{
+    uint32_t time = timer_hw->timelr; // Locks time until we read TIMEHR.
+    return (uint64_t(timer_hw->timehr) << 32) | time;
+}
+
+/**
+ * \brief system clock cycles per microsecond.
+ */
+inline uint32_t hal_cycles_per_us()
+{return clock_get_hz(clk_sys) / 1'000'000;}
+
+/**
+ * \brief spin until the 32-bit microsecond timer reaches the deadline.
+ * \return the timer value that ended the wait.
+ */
+inline uint32_t hal_busy_wait_until_us_32(uint32_t deadline_us)
+{
+    uint32_t now_us;
+    while (int32_t((now_us = timer_hw->timerawl) - deadline_us) < 0)
+        tight_loop_contents();
+    return now_us;
+}
+
+/**
+ * \brief claim the edge alarm and route its interrupt to handler on the
+ *  calling core at the highest priority.
+ */
+inline void hal_alarm_init(void (*handler)())
+{
+    hardware_alarm_claim(FIP_ALARM_NUM);
+    irq_set_exclusive_handler(TIMER_IRQ_0 + FIP_ALARM_NUM, handler);
+    irq_set_priority(TIMER_IRQ_0 + FIP_ALARM_NUM, PICO_HIGHEST_IRQ_PRIORITY);
+    hw_set_bits(&timer_hw->inte, 1u << FIP_ALARM_NUM);
+    irq_set_enabled(TIMER_IRQ_0 + FIP_ALARM_NUM, true);
+}
+
+/**
+ * \brief disarm the edge alarm and drop any interrupt it already raised.
+ */
+inline void hal_alarm_disarm()
+{
+    timer_hw->armed = 1u << FIP_ALARM_NUM;
+    timer_hw->intr = 1u << FIP_ALARM_NUM;
+    irq_clear(TIMER_IRQ_0 + FIP_ALARM_NUM);
+}
+
+/**
+ * \brief fire the edge alarm when the 32-bit microsecond timer reaches the
+ *  deadline.
+ * \return false (and leave the alarm disarmed) if the deadline has already
+ *  passed. The alarm only fires on an exact match, so it would otherwise not
+ *  fire until the timer wraps.
+ */
+inline bool hal_alarm_arm(uint32_t deadline_us)
+{
+    timer_hw->alarm[FIP_ALARM_NUM] = deadline_us;
+    if (int32_t(deadline_us - timer_hw->timerawl) > 0)
+        return true;
+    hal_alarm_disarm();
+    return false;
+}
+
+/**
+ * \brief acknowledge the edge alarm interrupt. Call first in the handler.
+ */
+inline void hal_alarm_clear()
+{timer_hw->intr = 1u << FIP_ALARM_NUM;}
+
+// Handler called from the trigger input's GPIO interrupt.
+inline void (*hal_trigger_handler)() = nullptr;
+
+/**
+ * \brief configure pin as an input and call handler on every rising edge,
+ *  from a GPIO interrupt routed to the calling core at the highest priority.
+ */
+inline void hal_trigger_init(uint32_t pin, void (*handler)())
+{
+    hal_trigger_handler = handler;
+    gpio_init(pin);
+    gpio_set_dir(pin, false);
+    gpio_set_irq_enabled_with_callback(pin, GPIO_IRQ_EDGE_RISE, true,
+        [](uint, uint32_t){hal_trigger_handler();});
+    irq_set_priority(IO_IRQ_BANK0, PICO_HIGHEST_IRQ_PRIORITY);
+}
+
+/**
+ * \brief stop interrupting on pin's rising edges.
+ */
+inline void hal_trigger_deinit(uint32_t pin)
+{gpio_set_irq_enabled(pin, GPIO_IRQ_EDGE_RISE, false);}
+
+/**
+ * \brief sleep until an interrupt or another core's SEV (i.e: a queue_t
+ *  write from core0).
+ */
+inline void hal_wait_for_event()
+{__wfe();}
+
+/**
+ * \brief (core0) wake core1 from hal_wait_for_event() after changing
+ *  something it reads without a queue_t (which wakes it on its own).
+ */
+inline void hal_send_event()
+{__sev();}
+
+// Sequence number of the last doorbell core0 rang to stop core1 mid-frame.
+inline std::atomic<uint32_t> hal_doorbell{0};
+// Sequence number of the last doorbell core1 answered. Core1 only.
+inline uint32_t hal_doorbell_answered = 0;
+
+/**
+ * \brief (core0) ask core1 to stop its outputs now, and wake it if it is
+ *  sleeping in hal_wait_for_event().
+ * \param sequence increases with every ring.
+ */
+inline void hal_doorbell_ring(uint32_t sequence)
+{
+    hal_doorbell.store(sequence, std::memory_order_release);
+    __sev();
+}
+
+/**
+ * \brief (core1) sequence number of the last ring.
+ */
+inline uint32_t hal_doorbell_sequence()
+{return hal_doorbell.load(std::memory_order_acquire);}
+
+/**
+ * \brief (core1) true if core0 rang the doorbell since core1 last answered.
+ */
+inline bool hal_doorbell_rung()
+{return hal_doorbell_sequence() != hal_doorbell_answered;}
+
+/**
+ * \brief (core1) answer every ring up to sequence.
+ */
+inline void hal_doorbell_answer(uint32_t sequence)
+{hal_doorbell_answered = sequence;}
+
+/**
+ * \brief hal_busy_wait_until_us_32() that also ends as soon as core0 rings
+ *  the doorbell.
+ * \return the timer value that ended the wait.
+ */
+inline uint32_t hal_busy_wait_until_us_32_or_doorbell(uint32_t deadline_us)
+{
+    uint32_t now_us;
+    while ((int32_t((now_us = timer_hw->timerawl) - deadline_us) < 0)
+           && !hal_doorbell_rung())
+        tight_loop_contents();
+    return now_us;
+}
+
+/**
+ * \brief drive the gpio pins in mask to the corresponding bits in value.
+ */
+inline void hal_gpio_put_masked(uint32_t mask, uint32_t value)
+{gpio_put_masked(mask, value);}
+
+/**
+ * \brief initialize the gpio pins in mask as outputs.
+ */
+inline void hal_gpio_init_outputs(uint32_t mask)
+{
+    gpio_init_mask(mask);
+    gpio_set_dir_masked(mask, 0xFFFFFFFF);
+}
+
+/**
+ * \brief configure the PWM slice of pin and leave it running. The pin's
+ *  output is connected separately with hal_pwm_put_masked().
+ * \param clkdiv_x16 clock divider in 8.4 fixed point.
+ */
+inline void hal_pwm_configure(uint32_t pin, uint16_t clkdiv_x16, uint16_t wrap,
+                              uint16_t level)
+{
+    uint32_t slice = pwm_gpio_to_slice_num(pin);
+    pwm_set_clkdiv_int_frac(slice, clkdiv_x16 >> 4, clkdiv_x16 & 0xF);
+    pwm_set_wrap(slice, wrap);
+    pwm_set_chan_level(slice, pwm_gpio_to_channel(pin), level);
+    pwm_set_enabled(slice, true);
+}
+
+/**
+ * \brief connect (value bit set) or disconnect (value bit cleared) each pin
+ *  in mask to its free-running PWM slice.
+ * \details a disconnected pin falls back to its SIO output, which must be
+ *  initialized as a LOW output beforehand.
+ */
+inline void hal_pwm_put_masked(uint32_t mask, uint32_t value)
+{
+    while (mask)
+    {
+        uint32_t pin = __builtin_ctz(mask);
+        gpio_set_function(pin, ((value >> pin) & 1u)? GPIO_FUNC_PWM: GPIO_FUNC_SIO);
+        mask &= mask - 1; // Clear lowest set bit.
+    }
+}
+#endif
+
+#endif // FIP_HAL_H
@@ -1,10 +1,16 @@
 #ifndef FIP_SCHEDULE_H
 #define FIP_SCHEDULE_H
 
-#include <hardware/timer.h>
+#include <fip_hal.h>
 #include <laser_fip_task.h>
+#include <fip_timeline.h>
+#include <task_table.h>
+#include <fip_ctrl_queues.h>
+#include <edge_telemetry.h>
+#include <pio_edge_table.h>
+#include <pio_edge_engine.h>
 #include <config.h>
-#include <etl/vector.h>
+#include <optional>
 
 
 inline constexpr uint32_t PWM_470_PIN = 1;
@@ -24,9 +30,27 @@ inline constexpr uint32_t DELTA4 = 50;
 inline constexpr uint32_t ENABLED_DIGITAL_OUTPUTS = 0xFFFFFFFF;
 
 
-extern etl::vector<LaserFIPTask, MAX_TASK_COUNT> laser_fip_task;
+extern std::optional<LaserFIPTask> fip_tasks[MAX_TASK_COUNT]; // by task slot.
+extern uint8_t fip_task_order[MAX_TASK_COUNT];
+extern size_t fip_task_count;
+extern FIPTimeline fip_timeline;
+extern uint32_t fixed_frame_period_us;
+extern TaskFrameDivisor fip_task_frame_divisors[MAX_TASK_COUNT];
+extern uint32_t frame_cycle_frame_count;
+extern uint32_t acquisition_frame_count;
+extern TriggerConfig trigger_config;
 
 extern bool enabled;
+extern uint32_t session_enable_sequence;
+extern bool start_pending;
+extern uint32_t scheduled_start_us;
+extern uint32_t frame_start_us;
+extern uint32_t frame_count;
+extern EdgeTelemetry edge_telemetry;
+extern EdgeTelemetrySnapshot edge_telemetry_snapshot;
+extern uint8_t schedule_backend;
+extern PIOEdgeTable pio_edge_table;
+extern PIOEdgeEngine pio_edge_engine;
 
 
 /**
@@ -34,29 +58,181 @@ extern bool enabled;
  */
 void run();
 
-void update_enabled_state();
+/**
+ * \brief one pass of run(): apply what core0 changed, then run the sequence
+ *  for a frame, wait a little for a scheduled start or, while disabled,
+ *  sleep until core0 signals a change (a command, a published task table or
+ *  the doorbell).
+ */
+void run_once();
 
-inline void update_fip_tasks();
+/**
+ * \brief apply every command core0 has sent, in order, and acknowledge each.
+ *  Aborts first if core0 rang the doorbell before sending a command, and
+ *  skips enables core0 sent before the last abort.
+ */
+void update_commands();
 
-void run_sequence();
+/**
+ * \brief apply one command from core0 (see Core1CommandType).
+ */
+void apply_command(const Core1Command& command);
 
-void run_exposure(LaserFIPTask& laser_fip_task);
+/**
+ * \brief if core0 rang the doorbell, stop the sequence mid-frame, drive
+ *  every output LOW and disable the schedule.
+ * \return true if the sequence was aborted.
+ * \details every wait core1 makes while outputs can be HIGH also ends on the
+ *  doorbell, so outputs stop within MAX_ABORT_LATENCY_US of the ring.
+ */
+bool update_abort_state();
 
-uint64_t time_us_64_unsafe();
-uint32_t time_us_32_fast();
+/**
+ * \brief whether a finite acquisition has run all of its frames.
+ */
+inline bool acquisition_complete()
+{return acquisition_frame_count && (frame_count >= acquisition_frame_count);}
 
-void sleep_us(uint32_t us);
+/**
+ * \brief move the trigger input interrupt to the new settings.
+ */
+void apply_trigger_config(const TriggerConfig& config);
 
+/**
+ * \brief whether the next frame cycle needs the timeline recompiled even
+ *  without a new table: the frames left in a finite acquisition end partway
+ *  through the compiled cycle, or frames are triggered one at a time from a
+ *  multi-frame cycle.
+ */
+bool next_cycle_differs();
 
-void setup_fip_schedule();
+/**
+ * \brief at a frame cycle boundary, swap in a pending task table, or cut the
+ *  timeline down to the frames left in a finite acquisition.
+ * \return whether the timeline was recompiled.
+ */
+bool prepare_next_cycle();
 
-void run();
+/**
+ * \brief stop a finite acquisition at the end of its last frame and report
+ *  the frames run and the time the last one ended to core0.
+ */
+void end_acquisition();
+
+/**
+ * \brief swap in the task table core0 published, if there is one, and
+ *  recompile the timeline. Only tasks whose settings changed are rebuilt.
+ * \param frame_index the first frame that runs with the new table.
+ * \return whether a table was applied.
+ */
+bool apply_task_table(uint32_t frame_index);
+
+/**
+ * \brief flatten one frame cycle of the current task list into fip_timeline,
+ *  each frame padded to the fixed frame period if there is one.
+ * \param first_frame_index index of the cycle's first frame, which selects
+ *  the tasks that run in each frame. A finite acquisition's last cycle stops
+ *  at its last frame, and frames triggered one at a time are compiled one at
+ *  a time.
+ */
+void compile_fip_timeline(uint32_t first_frame_index);
+
+/**
+ * \brief encode the compiled timeline for the PIO and load it.
+ * \return false if the frame can't be generated by the PIO.
+ */
+bool load_pio_edge_engine();
+
+/**
+ * \brief compile the timeline, anchor the first frame to the current time,
+ *  and clear the edge telemetry. Falls back to the CPU backend if the PIO
+ *  backend is selected but can't generate the frame. The timer IRQ backend
+ *  arms the alarm for the first edge. With a trigger input, the first frame
+ *  waits for on_trigger() instead.
+ */
+void start_sequence();
+
+/**
+ * \brief start_sequence() with the first frame anchored to start_us (see
+ *  hal_time_us_32()), so that boards sharing a clock start on the same tick.
+ *  core1 waits for the start time. A start time that has passed, or is too
+ *  close for the backend to start on, starts as soon as possible instead.
+ */
+void start_sequence_at(uint32_t start_us);
 
-void run_sequence(uint32_t output_state, uint64_t time_us);
+/**
+ * \brief (run_once()) wait for the pending scheduled start for at most
+ *  SCHEDULED_START_POLL_US, then return so that core0's commands apply.
+ *  Starts the sequence with start_sequence_at() SCHEDULED_START_SETUP_US
+ *  before the start time.
+ */
+void wait_for_scheduled_start();
 
-void run_exposure(PWM& laser, uint32_t camera_mask);
+/**
+ * \brief stop generating outputs and drive them all LOW.
+ */
+void stop_sequence();
 
-void push_harp_msg(uint32_t output_state, uint64_t time_us);
+/**
+ * \brief replay one frame of the compiled timeline.
+ * \details every edge waits for an absolute deadline relative to the frame
+ *  start, and every frame starts exactly one frame period after the last, so
+ *  output latency never accumulates across edges or frames. The lateness of
+ *  every edge is recorded and published to core0 once per frame. Ends a
+ *  finite acquisition after its last frame.
+ */
+void run_sequence();
+
+/**
+ * \brief run_sequence() for the CPU backend: core1 busy-waits for every edge.
+ */
+void run_cpu_sequence();
+
+/**
+ * \brief run_sequence() for the PIO backend. The PIO drives every edge, so
+ *  core1 only reports events, timestamped with each edge's exact deadline.
+ */
+void run_pio_sequence();
+
+/**
+ * \brief run_sequence() for the timer IRQ backend. Edges are written from
+ *  on_edge_alarm(), so core1 just sleeps until an interrupt or a message from
+ *  core0 and returns so that run() can apply its commands. At the end of a
+ *  cycle that on_edge_alarm() left for it, it swaps in the new task table (or
+ *  the shortened last cycle) and arms the alarm for the next cycle.
+ */
+void run_timer_irq_sequence();
+
+/**
+ * \brief timer alarm handler for the timer IRQ backend. Writes every edge
+ *  that is due and arms the alarm for the next one. Never compiles the
+ *  timeline: a cycle that needs recompiling is left to
+ *  run_timer_irq_sequence().
+ */
+void on_edge_alarm();
+
+/**
+ * \brief trigger input interrupt handler. If core1 is waiting for a trigger,
+ *  starts the next frame TRIGGER_START_DELAY_US after the edge. Edges
+ *  while a frame runs are ignored.
+ */
+void on_trigger();
+
+/**
+ * \brief publish the latency from the last trigger to the first edge of the
+ *  frame it started.
+ */
+void record_trigger_latency(uint32_t first_edge_us);
+
+/**
+ * \brief apply one compiled edge to the outputs.
+ */
+void apply_edge(const FIPEdge& edge);
+
+/**
+ * \brief send a rising edge event to core0. Wait-free.
+ */
+void push_harp_msg(uint32_t output_state, uint32_t time_us);
 
 
 #endif //FIP_SCHEDULE_H
@@ -0,0 +1,107 @@
+#ifndef FIP_TIMELINE_H
+#define FIP_TIMELINE_H
+#include <cstdint>
+#include <cstddef>
+#include <config.h>
+#include <laser_fip_task.h>
+
+/**
+ * \brief one precomputed output change within a frame.
+ */
+struct FIPEdge
+{
+    uint32_t offset_us;         /// time of the edge relative to the frame start.
+    uint32_t set_mask;          /// gpio outputs to drive high.
+    uint32_t clear_mask;        /// gpio outputs to drive low.
+    uint32_t pwm_enable_mask;   /// laser pins with PWM output enabled after the edge.
+    uint32_t event_state;       /// output state reported with the edge's event.
+    bool event;                 /// if true, the edge emits an event (see TaskEventFlags).
+};
+
+inline constexpr size_t EDGES_PER_TASK = 4;
+// Enough for every task in every frame of the longest frame cycle.
+inline constexpr size_t MAX_EDGE_COUNT
+    = EDGES_PER_TASK * MAX_TASK_COUNT * MAX_CYCLE_FRAME_COUNT;
+
+/**
+ * \brief every edge of one cycle of the FIP sequence (one or more frames
+ *  that then repeat), flattened from the task list so that core1 can replay
+ *  it without touching the tasks.
+ */
+class FIPTimeline
+{
+public:
+    FIPTimeline(): edge_count_{0}, period_us_{0}, frame_start_us_{0},
+                   frame_count_{0}, pwm_state_{0}, pipelined_{false},
+                   frame_first_edge_{0}, frame_exposure_count_{0} {}
+
+/**
+ * \brief remove all edges. Keeps the pipelining mode.
+ */
+    void clear();
+
+/**
+ * \brief pipeline the exposures of the tasks appended from here on (see
+ *  pipelined_start_us()) instead of running them one after another.
+ */
+    inline void set_pipelined(bool pipelined)
+    {pipelined_ = pipelined;}
+
+/**
+ * \brief append the four edges of one laser exposure after the current end
+ *  of the frame or, if pipelined, at the earliest start its constraints
+ *  allow. Edges of pipelined tasks interleave with the earlier ones.
+ * \return false if the timeline is full.
+ */
+    bool append_task(const LaserFIPTaskSettings& settings);
+
+/**
+ * \brief close the current frame. Tasks appended after this run in the next
+ *  one.
+ * \param fixed_frame_period_us 0: the frame lasts as long as its tasks.
+ *  Otherwise, the idle gap at the end of the frame is lengthened so that the
+ *  frame lasts exactly this long.
+ * \return false if the tasks already take longer than fixed_frame_period_us.
+ */
+    bool end_frame(uint32_t fixed_frame_period_us);
+
+    inline size_t edge_count() const
+    {return edge_count_;}
+
+/**
+ * \brief time from the start of the first frame to the start of the next
+ *  cycle: the sum of every frame's period.
+ */
+    inline uint32_t period_us() const
+    {return period_us_;}
+
+/**
+ * \brief frames closed with end_frame().
+ */
+    inline uint32_t frame_count() const
+    {return frame_count_;}
+
+    inline const FIPEdge& operator[](size_t index) const
+    {return edges_[index];}
+
+    inline const FIPEdge* begin() const
+    {return edges_;}
+
+    inline const FIPEdge* end() const
+    {return edges_ + edge_count_;}
+
+private:
+    FIPEdge edges_[MAX_EDGE_COUNT];
+    size_t edge_count_;
+    uint32_t period_us_;
+    uint32_t frame_start_us_; /// offset of the frame tasks are appended to.
+    uint32_t frame_count_;
+    uint32_t pwm_state_; /// laser pins enabled at the end of the frame so far.
+    bool pipelined_;
+    size_t frame_first_edge_; /// index of the current frame's first edge.
+    TaskExposure frame_exposures_[MAX_TASK_COUNT]; /// pipelined tasks placed
+                                                   /// in the current frame.
+    size_t frame_exposure_count_;
+};
+
+#endif // FIP_TIMELINE_H
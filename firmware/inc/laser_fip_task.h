@@ -1,6 +1,21 @@
 #ifndef LASER_FIP_TASK_H
 #define LASER_FIP_TASK_H
-#include <pwm.h>
+#include <cstddef>
+#include <fip_hal.h>
+
+// LaserFIPTaskSettings::events flags. Each EVENT_* flag makes one edge of the
+// task emit a rising edge event. EVENTS_ENABLED on its own keeps the original
+// meaning of events = 1: laser on and camera on.
+enum TaskEventFlags: uint8_t
+{
+    EVENTS_ENABLED = 1u << 0,
+    EVENT_LASER_ON = 1u << 1,
+    EVENT_CAMERA_ON = 1u << 2,
+    EVENT_CAMERA_OFF = 1u << 3,
+    EVENT_LASER_OFF = 1u << 4,
+};
+inline constexpr uint8_t EDGE_EVENT_FLAGS = EVENT_LASER_ON | EVENT_CAMERA_ON
+                                            | EVENT_CAMERA_OFF | EVENT_LASER_OFF;
 
 #pragma pack(push, 1)
 struct LaserFIPTaskSettings
@@ -11,7 +26,7 @@ struct LaserFIPTaskSettings
 
     uint32_t output_mask;
 
-    uint8_t events; // if true, rising-edge event msgs are enabled.
+    uint8_t events; // TaskEventFlags selecting which edges emit event msgs.
     uint8_t mute;   // if true, the task will take place, but all outputs will stay LOW.
 
     uint32_t delta1_us;
@@ -20,6 +35,16 @@ struct LaserFIPTaskSettings
     uint32_t delta4_us;
 
 
+/**
+ * \brief EVENT_* flags of the edges that emit events.
+ */
+    inline uint8_t edge_events() const
+    {
+        if (events & EDGE_EVENT_FLAGS)
+            return events & EDGE_EVENT_FLAGS;
+        return (events & EVENTS_ENABLED)? (EVENT_LASER_ON | EVENT_CAMERA_ON): 0;
+    }
+
 /**
  * \brief convert single pin set in a pin mask to its corresponding integer
  *  representation.
@@ -43,30 +68,105 @@ struct LaserFIPTaskSettings
 #pragma pack(pop)
 
 
+/**
+ * \brief RP2040 PWM slice register values for a laser's PWM waveform.
+ * \details resolved once from the float duty cycle and frequency (on core0)
+ *  so that core1 only writes registers, and every board running at the same
+ *  system clock generates a bit-identical waveform.
+ */
+struct LaserPWMConfig
+{
+    uint16_t clkdiv_x16; /// clock divider in 8.4 fixed point (16: divide by 1).
+    uint16_t wrap;       /// the counter wraps after wrap + 1 divided clocks.
+    uint16_t level;      /// HIGH for the first level divided clocks. > wrap: always HIGH.
+
+/**
+ * \brief the closest PWM waveform the slice can generate. Uses the smallest
+ *  clock divider that fits the period so that the duty cycle has the finest
+ *  resolution. Frequencies below ~7.5Hz (at 125MHz) saturate to the slowest
+ *  period. A duty cycle of 0 or 1 (or a frequency of 0) is a constant level.
+ */
+    static LaserPWMConfig resolve(float duty_cycle, float frequency_hz,
+                                  uint32_t sys_clk_hz);
+
+/**
+ * \brief PWM period in (rounded) system clock cycles.
+ */
+    inline uint32_t period_cycles() const
+    {return ((uint32_t(wrap) + 1) * clkdiv_x16 + 8) / 16;}
+
+/**
+ * \brief HIGH time per period in (rounded) system clock cycles.
+ */
+    inline uint32_t high_cycles() const
+    {
+        if (level > wrap)
+            return period_cycles();
+        return (uint32_t(level) * clkdiv_x16 + 8) / 16;
+    }
+
+    bool operator==(const LaserPWMConfig&) const = default;
+};
+
+
+/**
+ * \brief where one task's exposure falls in a frame (us, on the same clock as
+ *  the start it was placed at).
+ */
+struct TaskExposure
+{
+    uint32_t laser_mask;
+    uint32_t camera_mask;   /// every output of the task, even if it is muted.
+    uint64_t start_us;      /// laser on.
+    uint64_t camera_on_us;
+    uint64_t camera_off_us;
+    uint64_t laser_off_us;
+    uint64_t end_us;        /// laser off plus delta2.
+
+    static TaskExposure place(const LaserFIPTaskSettings& settings,
+                              uint64_t start_us);
+};
+
+/**
+ * \brief earliest start of a task that pipelines its exposure with the tasks
+ *  already placed in its frame.
+ * \details tasks start in order. A task that shares a laser or camera pin with
+ *  an earlier one waits for it to end (delta2 included). Otherwise its laser
+ *  may warm up (delta3) while the earlier task's laser is still on, and run
+ *  while the earlier camera reads out (delta4, delta2), as long as neither
+ *  laser is on during the other task's camera exposure.
+ * \param frame_start_us the earliest the task can start.
+ */
+uint64_t pipelined_start_us(const LaserFIPTaskSettings& settings,
+                            uint64_t frame_start_us, const TaskExposure* placed,
+                            size_t placed_count);
+
+
 class  LaserFIPTask
 {
 public:
 /**
- * \brief constructor.
+ * \brief constructor. Configures the outputs and starts the laser's PWM
+ *  slice with its pin left as a LOW gpio output.
  */
-    LaserFIPTask(size_t pwm_pin, float pwm_duty_cycle, float pwm_frequency_hz,
-                 uint32_t output_mask, bool enable_events, bool mute_output,
-                 uint32_t delta1_us, uint32_t delta2_us, uint32_t delta3_us,
-                 uint32_t delta4_us);
+    LaserFIPTask(const LaserFIPTaskSettings& settings, const LaserPWMConfig& pwm);
 
      ~LaserFIPTask();
 
 /**
- * \brief apply the settings specified.
+ * \brief apply the settings specified, touching only the hardware they
+ *  change: new outputs or laser pin are configured as in the constructor,
+ *  and a new PWM waveform on the same pin is one slice configuration.
+ *  Timing, event and mute changes only update settings_.
  */
-    inline void apply_settings(LaserFIPTaskSettings& settings)
-    {settings_ = settings;} // Use default assignment operator.
+    void apply_settings(const LaserFIPTaskSettings& settings,
+                        const LaserPWMConfig& pwm);
 
     inline void set_output()
-    {gpio_put_masked(output_mask(), 0xFFFFFFFF);}
+    {hal_gpio_put_masked(output_mask(), 0xFFFFFFFF);}
 
     inline void clear_output()
-    {gpio_put_masked(settings_.output_mask, 0);}
+    {hal_gpio_put_masked(settings_.output_mask, 0);}
 
     inline uint32_t output_mask()
     {
@@ -75,7 +175,13 @@ public:
         return settings_.output_mask;
     }
 
+    inline uint32_t pwm_pin() const
+    {return pwm_pin_;}
+
     LaserFIPTaskSettings settings_;
-    PWM laser_;
+    LaserPWMConfig pwm_;
+
+private:
+    uint32_t pwm_pin_;
 };
 #endif // LASER_FIP_TASK_H
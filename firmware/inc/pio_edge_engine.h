@@ -0,0 +1,59 @@
+#ifndef PIO_EDGE_ENGINE_H
+#define PIO_EDGE_ENGINE_H
+#include <cstdint>
+#include <pio_edge_table.h>
+
+/**
+ * \brief generates the FIP outputs from a PIO state machine fed by DMA so
+ *  that edges are cycle-exact and core1 is free while the schedule runs.
+ * \details two chained DMA channels loop the PIOEdgeTable into the state
+ *  machine's TX FIFO forever: a data channel streams the frame, then a
+ *  control channel rewinds it.
+ */
+class PIOEdgeEngine
+{
+public:
+    PIOEdgeEngine()
+    : table_{nullptr}, table_words_{nullptr}, pin_mask_{0}, running_{false},
+      initialized_{false} {}
+
+/**
+ * \brief hand the table's pins to the PIO (LOW), load the state machine and
+ *  prefill its FIFO. The outputs don't change until start().
+ * \warning table must stay untouched until stop().
+ */
+    void load(const PIOEdgeTable& table);
+
+/**
+ * \brief start the state machine. The first word is driven on this cycle.
+ */
+    void start();
+
+/**
+ * \brief stop the state machine and DMA and return the table's pins to LOW
+ *  gpio outputs.
+ */
+    void stop();
+
+    inline bool running() const
+    {return running_;}
+
+private:
+/**
+ * \brief claim the state machine and DMA channels on first use.
+ */
+    void init();
+
+    const PIOEdgeTable* table_;
+    const uint32_t* table_words_; /// read by the DMA control channel.
+    uint32_t pin_mask_;
+    bool running_;
+
+    bool initialized_;
+    uint32_t program_offset_;
+    uint32_t sm_;
+    uint32_t data_channel_;
+    uint32_t ctrl_channel_;
+};
+
+#endif // PIO_EDGE_ENGINE_H
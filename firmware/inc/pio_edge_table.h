@@ -0,0 +1,94 @@
+#ifndef PIO_EDGE_TABLE_H
+#define PIO_EDGE_TABLE_H
+#include <cstdint>
+#include <cstddef>
+#include <config.h>
+#include <fip_timeline.h>
+
+// Words per frame. Each laser PWM period inside an exposure costs two words.
+inline constexpr size_t PIO_EDGE_TABLE_CAPACITY = 4096;
+// The fip_edge_engine program spends 3 cycles per word before its hold loop.
+inline constexpr uint32_t PIO_EDGE_MIN_HOLD_CYCLES = 3;
+// 24-bit hold count. Kept PIO_EDGE_MIN_HOLD_CYCLES below the program's limit
+// so a dropped sub-minimum state can always be folded into the previous word.
+inline constexpr uint32_t PIO_EDGE_MAX_HOLD_CYCLES = (1u << 24) - 1;
+inline constexpr uint32_t PIO_EDGE_PIN_COUNT = 8; // IO0 through IO7.
+inline constexpr uint32_t PIO_EDGE_PIN_MASK = ((1u << PIO_EDGE_PIN_COUNT) - 1) << PORT_BASE;
+
+/**
+ * \brief a laser's PWM waveform in system clock cycles.
+ */
+struct LaserPWMTiming
+{
+    uint32_t pin_mask;
+    uint32_t period_cycles;
+    uint32_t high_cycles;   /// 0: always LOW. >= period_cycles: always HIGH.
+
+    static LaserPWMTiming from_config(uint32_t pin_mask, const LaserPWMConfig& pwm);
+};
+
+/**
+ * \brief one frame of the FIP timeline encoded for the fip_edge_engine PIO
+ *  program.
+ * \details each word holds the IO0..IO7 output levels in bits [7:0] and a
+ *  hold count in bits [31:8]. The PIO drives the levels and holds them for
+ *  exactly (hold count + 3) cycles. Laser PWM is synthesized into the word
+ *  stream, phase-aligned to each laser-on edge, so the PIO owns every pin the
+ *  schedule uses.
+ */
+class PIOEdgeTable
+{
+public:
+    PIOEdgeTable(): word_count_{0}, pin_mask_{0}, frame_cycles_{0} {}
+
+/**
+ * \brief encode one frame of the timeline.
+ * \param pwm_timings PWM waveform of every laser pin the timeline enables.
+ * \return false if the frame does not fit in the table or uses pins outside
+ *  IO0 through IO7.
+ */
+    bool encode(const FIPTimeline& timeline, const LaserPWMTiming* pwm_timings,
+                size_t pwm_timing_count, uint32_t cycles_per_us);
+
+    static inline uint32_t encode_word(uint32_t hold_cycles, uint32_t output_state)
+    {
+        return ((hold_cycles - PIO_EDGE_MIN_HOLD_CYCLES) << PIO_EDGE_PIN_COUNT)
+               | ((output_state >> PORT_BASE) & ((1u << PIO_EDGE_PIN_COUNT) - 1));
+    }
+
+    inline const uint32_t* words() const
+    {return words_;}
+
+    inline size_t word_count() const
+    {return word_count_;}
+
+/**
+ * \brief gpio pins driven by the schedule.
+ */
+    inline uint32_t pin_mask() const
+    {return pin_mask_;}
+
+    inline uint32_t frame_cycles() const
+    {return frame_cycles_;}
+
+private:
+    bool emit(uint32_t hold_cycles, uint32_t output_state);
+
+/**
+ * \brief end the pending output state at cycle.
+ * \return the cycle at which the next output state starts.
+ */
+    bool close_pending(uint32_t cycle, uint32_t& next_start_cycle);
+
+    bool breakpoint(uint32_t cycle, uint32_t output_state);
+
+    uint32_t words_[PIO_EDGE_TABLE_CAPACITY];
+    size_t word_count_;
+    uint32_t pin_mask_;
+    uint32_t frame_cycles_;
+
+    uint32_t pending_state_;
+    uint32_t pending_start_cycle_;
+};
+
+#endif // PIO_EDGE_TABLE_H
@@ -0,0 +1,50 @@
+#ifndef RISING_EDGE_EVENT_BATCH_H
+#define RISING_EDGE_EVENT_BATCH_H
+#include <cstdint>
+#include <cstddef>
+
+inline constexpr size_t RISING_EDGE_EVENT_BATCH_CAPACITY = 16;
+// Send a partial batch once its first event is this old.
+inline constexpr uint32_t RISING_EDGE_EVENT_BATCH_TIMEOUT_US = 100'000;
+// Largest time offset an event word can hold.
+inline constexpr uint32_t RISING_EDGE_EVENT_BATCH_MAX_OFFSET_US = (1u << 24) - 1;
+
+/**
+ * \brief rising edge events packed into one Harp message.
+ * \details word 0 holds the event count. Each following word holds one event:
+ *  the IO0..IO7 port state in bits [31:24] and the time (us) since the first
+ *  event in bits [23:0]. The message timestamp is the first event's time.
+ *  Unused words are zero.
+ */
+class EventBatch
+{
+public:
+    EventBatch() {clear();}
+
+    void clear();
+
+/**
+ * \brief append an event.
+ * \return false if the batch is full or the event is too long after the
+ *  first one for its time offset to fit.
+ */
+    bool add(uint8_t port_state, uint64_t time_us);
+
+    inline size_t count() const
+    {return words_[0];}
+
+    inline uint64_t first_time_us() const
+    {return first_time_us_;}
+
+    inline const uint32_t* words() const
+    {return words_;}
+
+    static constexpr size_t word_count()
+    {return RISING_EDGE_EVENT_BATCH_CAPACITY + 1;}
+
+private:
+    uint32_t words_[RISING_EDGE_EVENT_BATCH_CAPACITY + 1];
+    uint64_t first_time_us_;
+};
+
+#endif // RISING_EDGE_EVENT_BATCH_H
@@ -0,0 +1,101 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <bit>
+
+/**
+ * \brief wait-free single-producer/single-consumer ring buffer.
+ * \details one core pushes and the other pops. Neither side takes a lock or
+ *  disables interrupts: each index is written by one side only and the
+ *  acquire/release pair on it orders the element copy. A push into a full
+ *  ring is dropped and counted instead of blocking the producer.
+ * \tparam N capacity. Must be a power of two.
+ */
+template <typename T, size_t N>
+class SPSCRing
+{
+    static_assert(std::has_single_bit(N), "SPSCRing capacity must be a power of two.");
+
+public:
+    SPSCRing(): head_{0}, tail_{0}, overflow_count_{0}, high_water_mark_{0} {}
+
+/**
+ * \brief push one element. Producer only.
+ * \return false (and count an overflow) if the ring is full.
+ */
+    inline bool try_push(const T& item)
+    {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        uint32_t level = head - tail_.load(std::memory_order_acquire);
+        if (level == N)
+        {
+            overflow_count_.store(overflow_count_.load(std::memory_order_relaxed) + 1,
+                                  std::memory_order_relaxed);
+            return false;
+        }
+        items_[head & (N - 1)] = item;
+        head_.store(head + 1, std::memory_order_release);
+        if (level + 1 > high_water_mark_.load(std::memory_order_relaxed))
+            high_water_mark_.store(level + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+/**
+ * \brief pop the oldest element. Consumer only.
+ * \return false if the ring is empty.
+ */
+    inline bool try_pop(T& item)
+    {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire))
+            return false;
+        item = items_[tail & (N - 1)];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+/**
+ * \brief elements waiting to be popped. Exact on the consumer side; a lower
+ *  bound on the producer side.
+ */
+    inline size_t size() const
+    {return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);}
+
+    inline bool empty() const
+    {return size() == 0;}
+
+    static constexpr size_t capacity()
+    {return N;}
+
+/**
+ * \brief pushes dropped because the ring was full.
+ */
+    inline uint32_t overflow_count() const
+    {return overflow_count_.load(std::memory_order_relaxed);}
+
+/**
+ * \brief most elements ever waiting at once.
+ */
+    inline uint32_t high_water_mark() const
+    {return high_water_mark_.load(std::memory_order_relaxed);}
+
+/**
+ * \brief zero the overflow count and high-water mark. Producer only.
+ */
+    inline void clear_stats()
+    {
+        overflow_count_.store(0, std::memory_order_relaxed);
+        high_water_mark_.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint32_t> head_; /// free-running. Written by the producer.
+    std::atomic<uint32_t> tail_; /// free-running. Written by the consumer.
+    std::atomic<uint32_t> overflow_count_;  /// written by the producer.
+    std::atomic<uint32_t> high_water_mark_; /// written by the producer.
+    T items_[N];
+};
+
+#endif // SPSC_RING_H
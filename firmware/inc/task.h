@@ -2,7 +2,7 @@
 #define TASK_H
 #include <cstdint>
 #include <cstdio>
-#include <hardware/timer.h>
+#include <fip_hal.h>
 
 
 /**
@@ -92,7 +92,7 @@ public:
  * \brief true if a task that requires updating due/overdue for an update.
  */
     virtual inline bool time_to_update()
-    {return int32_t(timer_hw->timerawl - next_update_time_us_) >= 0;}
+    {return int32_t(hal_time_us_32() - next_update_time_us_) >= 0;}
 
 /**
  * \brief true if update() must be called again in the future.
@@ -0,0 +1,214 @@
+#ifndef TASK_TABLE_H
+#define TASK_TABLE_H
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <config.h>
+#include <laser_fip_task.h>
+
+// TaskTableSwap::applied_frame() before any table has been applied.
+inline constexpr uint32_t NO_APPLIED_FRAME = UINT32_MAX;
+
+// add_task_slot() when every slot is taken, and TaskOrder entries past the
+// last task.
+inline constexpr uint8_t NO_TASK_SLOT = 0xFF;
+static_assert(MAX_TASK_COUNT < NO_TASK_SLOT, "Task slots must fit in a byte.");
+
+/**
+ * \brief which frames a task runs in: frames whose index (counted from when
+ *  the schedule was enabled) is phase modulo divisor. A divisor of 0 or 1
+ *  runs the task in every frame. Frames a task skips are shorter by the
+ *  task's duration.
+ */
+struct TaskFrameDivisor
+{
+    uint8_t divisor;
+    uint8_t phase;
+
+    inline bool runs_in_frame(uint32_t frame_index) const
+    {return (divisor <= 1) || ((frame_index % divisor) == phase);}
+};
+
+/**
+ * \brief every task setting (in GPIO pin space) of one schedule.
+ * \details each task keeps the slot it was added in until it is removed, so
+ *  removing a task moves no other task's settings. The tasks run in the order
+ *  listed in order[].
+ */
+struct TaskTable
+{
+    uint8_t task_count; /// tasks in order[].
+    uint8_t order[MAX_TASK_COUNT]; /// slot of each task, in the order they run.
+    bool slot_used[MAX_TASK_COUNT];
+    LaserFIPTaskSettings tasks[MAX_TASK_COUNT]; /// by slot, like pwm and frame_divisors.
+    LaserPWMConfig pwm[MAX_TASK_COUNT]; /// each task's PWM, resolved by core0.
+    TaskFrameDivisor frame_divisors[MAX_TASK_COUNT];
+    uint32_t fixed_frame_period_us; /// 0: each frame lasts as long as its tasks.
+    bool pipelined_exposures; /// overlap exposures (see pipelined_start_us()).
+};
+
+/**
+ * \brief take the lowest free slot for a new task that runs after the others.
+ *  The slot's settings are left for the caller to fill in.
+ * \details scans slot_used[], so O(MAX_TASK_COUNT). Only core0 edits tables,
+ *  one register write at a time.
+ * \return the slot, or NO_TASK_SLOT if every slot is taken.
+ */
+size_t add_task_slot(TaskTable& table);
+
+/**
+ * \brief free a task's slot and take it out of the run order. The other tasks
+ *  keep their slots, and no settings move.
+ * \details shifts the tasks that run after it down in order[], so
+ *  O(task_count): order[] stays dense for core1 and LaserTaskOrder to
+ *  iterate.
+ */
+void remove_task_slot(TaskTable& table, size_t slot);
+
+/**
+ * \brief free every slot, in O(task_count).
+ */
+void clear_task_slots(TaskTable& table);
+
+/**
+ * \brief why a task schedule can't run.
+ */
+enum ScheduleError
+{
+    SCHEDULE_OK = 0,
+    SCHEDULE_PIN_CONFLICT = 1,      /// a laser pin is also a camera output.
+    SCHEDULE_CAMERA_OVERLAP = 2,    /// a camera's exposures are empty or touch.
+    SCHEDULE_EMPTY_FRAME = 3,       /// a frame with no duration, or with no
+                                    /// tasks while every frame waits for a
+                                    /// trigger.
+    SCHEDULE_FRAME_TOO_LONG = 4,    /// a frame longer than MAX_FRAME_PERIOD_US.
+    SCHEDULE_FRAME_OVERRUN = 5,     /// tasks longer than the fixed frame period.
+    SCHEDULE_BAD_FRAME_DIVISOR = 6, /// a phase past its divisor, or frames
+                                    /// that don't repeat within
+                                    /// MAX_CYCLE_FRAME_COUNT.
+};
+
+/**
+ * \brief one camera's exposures through a frame cycle, checked one at a time
+ *  in the order they start.
+ */
+struct CameraExposureWalk
+{
+    size_t exposure_count = 0;
+    uint64_t first_on_us = 0;
+    uint64_t last_off_us = 0;
+
+/**
+ * \return false if the exposure is empty, or starts before (or as) the
+ *  previous one ends.
+ */
+    bool append(uint64_t on_us, uint64_t off_us);
+
+/**
+ * \return false if the last exposure hasn't ended before the first one
+ *  starts again, one cycle later.
+ */
+    bool wraps(uint64_t cycle_period_us) const;
+};
+
+/**
+ * \brief frames after which the schedule repeats: the least common multiple
+ *  of the task frame divisors.
+ * \return 0 if a phase isn't less than its divisor or the cycle is longer
+ *  than MAX_CYCLE_FRAME_COUNT.
+ */
+uint32_t frame_cycle_length(const TaskTable& table);
+
+/**
+ * \brief time (us) the tasks that run in a frame take, without padding: from
+ *  the first laser on to the end of the task that ends last.
+ */
+uint64_t frame_task_time_us(const TaskTable& table, uint32_t frame_index);
+
+/**
+ * \brief whether some frame of the cycle runs no task, and only lasts the
+ *  fixed frame period.
+ */
+bool has_empty_frame(const TaskTable& table);
+
+/**
+ * \brief every pin a task drives: its laser's PWM pin and its outputs.
+ */
+uint32_t task_output_pins(const TaskTable& table);
+
+/**
+ * \brief check that the tasks form frames the scheduler can replay: no pin
+ *  is both a laser and a camera output, the frames repeat within
+ *  MAX_CYCLE_FRAME_COUNT, every camera exposure has a length and is
+ *  separated from the camera's next one (in this frame or the next), every
+ *  frame's tasks fit in the fixed frame period (if there is one), and every
+ *  frame lasts between 1us and MAX_FRAME_PERIOD_US. No tasks at all is a
+ *  valid (empty) schedule.
+ */
+ScheduleError check_schedule(const TaskTable& table);
+
+/**
+ * \brief duration of one frame cycle of a valid schedule (see
+ *  frame_cycle_length()), saturated at UINT32_MAX. 0 if there are no tasks.
+ */
+uint32_t frame_cycle_period_us(const TaskTable& table);
+
+/**
+ * \brief fraction of each frame cycle of a valid schedule that the laser on
+ *  pwm_pin_bit emits: the time its PWM is enabled, weighted by the PWM duty
+ *  cycle.
+ */
+float laser_duty_fraction(const TaskTable& table, uint32_t pwm_pin_bit);
+
+/**
+ * \brief hands a complete TaskTable from core0 to core1 while the schedule
+ *  runs.
+ * \details core0 edits its own shadow table and publishes a copy; core1 keeps
+ *  running from its active tasks and swaps the published table in at the
+ *  next frame boundary, so a frame never mixes old and new settings. The
+ *  buffer belongs to core0 until it is published and to core1 until it is
+ *  released; neither side waits on the other.
+ */
+class TaskTableSwap
+{
+public:
+    TaskTableSwap(): pending_{false}, applied_frame_{NO_APPLIED_FRAME}, table_{} {}
+
+/**
+ * \brief copy table in and hand it to core1. Core0 only.
+ * \return false if core1 has not released the previously published table.
+ */
+    bool try_publish(const TaskTable& table);
+
+/**
+ * \brief the published table, or nullptr if there is none. Core1 only.
+ */
+    const TaskTable* pending() const;
+
+/**
+ * \brief hand the published table back to core0 once it is applied. Core1
+ *  only.
+ * \param frame_index the first frame (counted from the session start) that
+ *  runs with the new table.
+ */
+    void release(uint32_t frame_index);
+
+/**
+ * \brief whether a published table is waiting for core1.
+ */
+    inline bool is_pending() const
+    {return pending_.load(std::memory_order_acquire);}
+
+/**
+ * \brief frame index passed to the last release(), or NO_APPLIED_FRAME.
+ */
+    inline uint32_t applied_frame() const
+    {return applied_frame_.load(std::memory_order_relaxed);}
+
+private:
+    std::atomic<bool> pending_; /// true from try_publish() until release().
+    std::atomic<uint32_t> applied_frame_;
+    TaskTable table_;
+};
+
+#endif // TASK_TABLE_H
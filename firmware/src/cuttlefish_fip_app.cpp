@@ -1,59 +1,340 @@
 #include <cuttlefish_fip_app.h>
 
 app_regs_t app_regs;
+EventBatch rising_edge_event_batch;
+TaskTable task_table; // core0's shadow of the tasks core1 runs.
+TaskTable edited_task_table; // task_table with one write's edits, until validated.
+bool task_table_dirty = false; // edited since it was last published.
+uint32_t last_enable_sequence = 0; // sequence number of the last enable sent.
 
-RegSpecs app_reg_specs[REG_COUNT]
-{
-    {(uint8_t*)&app_regs.EnableTaskSchedule, sizeof(app_regs.EnableTaskSchedule), U8},
-    {(uint8_t*)&app_regs.AddLaserTask, sizeof(app_regs.AddLaserTask), U8},
-    {(uint8_t*)&app_regs.RemoveLaserTask, sizeof(app_regs.RemoveLaserTask), U8},
-    {(uint8_t*)&app_regs.RemoveAllLaserTasks, sizeof(app_regs.RemoveAllLaserTasks), U8},
-    {(uint8_t*)&app_regs.LaserTaskCount, sizeof(app_regs.LaserTaskCount), U8},
-    {(uint8_t*)&app_regs.RisingEdgeEvent, sizeof(app_regs.RisingEdgeEvent), U8},
-    {(uint8_t*)&app_regs.ReconfigureLaserTask[0], sizeof(LaserFIPTaskSettings), U8},
-    {(uint8_t*)&app_regs.ReconfigureLaserTask[1], sizeof(LaserFIPTaskSettings), U8},
-    {(uint8_t*)&app_regs.ReconfigureLaserTask[2], sizeof(LaserFIPTaskSettings), U8},
-    {(uint8_t*)&app_regs.ReconfigureLaserTask[3], sizeof(LaserFIPTaskSettings), U8},
-    {(uint8_t*)&app_regs.ReconfigureLaserTask[4], sizeof(LaserFIPTaskSettings), U8},
-    {(uint8_t*)&app_regs.ReconfigureLaserTask[5], sizeof(LaserFIPTaskSettings), U8},
-    {(uint8_t*)&app_regs.ReconfigureLaserTask[6], sizeof(LaserFIPTaskSettings), U8},
-    {(uint8_t*)&app_regs.ReconfigureLaserTask[7], sizeof(LaserFIPTaskSettings), U8},
-};
-
-RegFnPair reg_handler_fns[REG_COUNT]
-{
-    {HarpCore::read_reg_generic, write_enable_task_schedule}, // read is technically undefined
-    {HarpCore::read_reg_generic, write_add_laser_task},       // read is technically undefined
-    {HarpCore::read_reg_generic, write_remove_laser_task},    // read is technically undefined
-    {HarpCore::read_reg_generic, write_remove_all_laser_tasks}, // read is technically undefined
-    {HarpCore::read_reg_generic, HarpCore::write_to_read_only_reg_error},
-    {HarpCore::read_reg_generic, HarpCore::write_to_read_only_reg_error},
-
-    {read_reconfigure_laser_task, write_reconfigure_laser_task},
-    {read_reconfigure_laser_task, write_reconfigure_laser_task},
-    {read_reconfigure_laser_task, write_reconfigure_laser_task},
-    {read_reconfigure_laser_task, write_reconfigure_laser_task},
-    {read_reconfigure_laser_task, write_reconfigure_laser_task},
-    {read_reconfigure_laser_task, write_reconfigure_laser_task},
-    {read_reconfigure_laser_task, write_reconfigure_laser_task},
-    {read_reconfigure_laser_task, write_reconfigure_laser_task},
-};
+LaserTaskTableData staged_laser_task_table[LASER_TASK_TABLE_PAGE_COUNT];
+size_t staged_laser_task_table_pages = 0; // pages of a longer table written so far.
+
+namespace
+{
+RegSpecs laser_task_reg_specs(size_t task_index)
+{
+    return {(uint8_t*)&app_regs.ReconfigureLaserTask[task_index],
+            sizeof(LaserFIPTaskSettings), U8};
+}
+
+// GPIO bit of a TriggerPin value (an IO pin bit).
+uint32_t trigger_pin_bit(uint8_t io_pin_bit)
+{return uint32_t(io_pin_bit) << PORT_BASE;}
+
+RegSpecs laser_task_table_reg_specs(size_t page)
+{
+    return {(uint8_t*)&app_regs.LaserTaskTable[page], sizeof(LaserTaskTableData), U8};
+}
+
+/**
+ * \brief the register map: the default registers in address order, with one
+ *  settings register per default task, then the settings registers of the
+ *  remaining tasks and the remaining LaserTaskTable pages.
+ */
+template <size_t... Task, size_t... ExtraTask, size_t... ExtraPage>
+std::array<RegSpecs, REG_COUNT> make_app_reg_specs(
+    std::index_sequence<Task...>, std::index_sequence<ExtraTask...>,
+    std::index_sequence<ExtraPage...>)
+{
+    return
+    {{
+        {(uint8_t*)&app_regs.EnableTaskSchedule, sizeof(app_regs.EnableTaskSchedule), U8},
+        {(uint8_t*)&app_regs.AddLaserTask, sizeof(app_regs.AddLaserTask), U8},
+        {(uint8_t*)&app_regs.RemoveLaserTask, sizeof(app_regs.RemoveLaserTask), U8},
+        {(uint8_t*)&app_regs.RemoveAllLaserTasks, sizeof(app_regs.RemoveAllLaserTasks), U8},
+        {(uint8_t*)&app_regs.LaserTaskCount, sizeof(app_regs.LaserTaskCount), U8},
+        {(uint8_t*)&app_regs.RisingEdgeEvent, sizeof(app_regs.RisingEdgeEvent), U8},
+        laser_task_reg_specs(Task)...,
+        {(uint8_t*)&app_regs.EdgeCount, sizeof(app_regs.EdgeCount), U32},
+        {(uint8_t*)&app_regs.EdgeDeadlineMissCount, sizeof(app_regs.EdgeDeadlineMissCount), U32},
+        {(uint8_t*)&app_regs.EdgeLatenessMin, sizeof(app_regs.EdgeLatenessMin), U32},
+        {(uint8_t*)&app_regs.EdgeLatenessMax, sizeof(app_regs.EdgeLatenessMax), U32},
+        {(uint8_t*)&app_regs.EdgeLatenessMeanNs, sizeof(app_regs.EdgeLatenessMeanNs), U32},
+        {(uint8_t*)&app_regs.EdgeLatenessHistogram, sizeof(app_regs.EdgeLatenessHistogram), U32},
+        {(uint8_t*)&app_regs.ScheduleBackend, sizeof(app_regs.ScheduleBackend), U8},
+        {(uint8_t*)&app_regs.ActiveScheduleBackend, sizeof(app_regs.ActiveScheduleBackend), U8},
+        {(uint8_t*)&app_regs.RisingEdgeEventOverflowCount, sizeof(app_regs.RisingEdgeEventOverflowCount), U32},
+        {(uint8_t*)&app_regs.RisingEdgeEventHighWaterMark, sizeof(app_regs.RisingEdgeEventHighWaterMark), U32},
+        {(uint8_t*)&app_regs.RisingEdgeEventBatchSize, sizeof(app_regs.RisingEdgeEventBatchSize), U8},
+        {(uint8_t*)&app_regs.RisingEdgeEventBatch, sizeof(app_regs.RisingEdgeEventBatch), U32},
+        {(uint8_t*)&app_regs.TaskSettingsAppliedFrame, sizeof(app_regs.TaskSettingsAppliedFrame), U32},
+        laser_task_table_reg_specs(0),
+        {(uint8_t*)&app_regs.PredictedFramePeriod, sizeof(app_regs.PredictedFramePeriod), U32},
+        {(uint8_t*)&app_regs.PredictedFrameRate, sizeof(app_regs.PredictedFrameRate), Float},
+        {(uint8_t*)&app_regs.PredictedLaserDutyCycle, sizeof(app_regs.PredictedLaserDutyCycle), Float},
+        {(uint8_t*)&app_regs.TaskScheduleError, sizeof(app_regs.TaskScheduleError), U8},
+        {(uint8_t*)&app_regs.FixedFramePeriod, sizeof(app_regs.FixedFramePeriod), U32},
+        {(uint8_t*)&app_regs.FramePeriodSlack, sizeof(app_regs.FramePeriodSlack), U32},
+        {(uint8_t*)&app_regs.TaskFrameDivisors, sizeof(app_regs.TaskFrameDivisors), U8},
+        {(uint8_t*)&app_regs.PipelinedExposures, sizeof(app_regs.PipelinedExposures), U8},
+        {(uint8_t*)&app_regs.AcquisitionFrameCount, sizeof(app_regs.AcquisitionFrameCount), U32},
+        {(uint8_t*)&app_regs.AcquisitionComplete, sizeof(app_regs.AcquisitionComplete), U32},
+        {(uint8_t*)&app_regs.ScheduledStartTime, sizeof(app_regs.ScheduledStartTime), U64},
+        {(uint8_t*)&app_regs.TriggerMode, sizeof(app_regs.TriggerMode), U8},
+        {(uint8_t*)&app_regs.TriggerPin, sizeof(app_regs.TriggerPin), U8},
+        {(uint8_t*)&app_regs.TriggerLatency, sizeof(app_regs.TriggerLatency), U32},
+        {(uint8_t*)&app_regs.LaserTaskOrder, sizeof(app_regs.LaserTaskOrder), U8},
+        {(uint8_t*)&app_regs.PendingCommandCount, sizeof(app_regs.PendingCommandCount), U32},
+        laser_task_reg_specs(DEFAULT_TASK_REG_COUNT + ExtraTask)...,
+        laser_task_table_reg_specs(1 + ExtraPage)...,
+    }};
+}
+
+/**
+ * \brief the handlers of every register in make_app_reg_specs(), in the same
+ *  order.
+ */
+template <size_t... Task, size_t... ExtraTask, size_t... ExtraPage>
+constexpr std::array<RegFnPair, REG_COUNT> make_reg_handler_fns(
+    std::index_sequence<Task...>, std::index_sequence<ExtraTask...>,
+    std::index_sequence<ExtraPage...>)
+{
+    constexpr RegFnPair laser_task_fns{read_reconfigure_laser_task,
+                                       write_reconfigure_laser_task};
+    constexpr RegFnPair laser_task_table_fns{read_laser_task_table,
+                                             write_laser_task_table};
+    return
+    {{
+        {HarpCore::read_reg_generic, write_enable_task_schedule}, // read is technically undefined
+        {HarpCore::read_reg_generic, write_add_laser_task},       // read is technically undefined
+        {HarpCore::read_reg_generic, write_remove_laser_task},    // read is technically undefined
+        {HarpCore::read_reg_generic, write_remove_all_laser_tasks}, // read is technically undefined
+        {HarpCore::read_reg_generic, HarpCore::write_to_read_only_reg_error},
+        {HarpCore::read_reg_generic, HarpCore::write_to_read_only_reg_error},
+
+        ((void)Task, laser_task_fns)...,
+
+        {read_edge_telemetry, HarpCore::write_to_read_only_reg_error},
+        {read_edge_telemetry, HarpCore::write_to_read_only_reg_error},
+        {read_edge_telemetry, HarpCore::write_to_read_only_reg_error},
+        {read_edge_telemetry, HarpCore::write_to_read_only_reg_error},
+        {read_edge_telemetry, HarpCore::write_to_read_only_reg_error},
+        {read_edge_telemetry, HarpCore::write_to_read_only_reg_error},
+
+        {HarpCore::read_reg_generic, write_schedule_backend},
+        {read_active_schedule_backend, HarpCore::write_to_read_only_reg_error},
+        {read_rising_edge_event_stats, HarpCore::write_to_read_only_reg_error},
+        {read_rising_edge_event_stats, HarpCore::write_to_read_only_reg_error},
+        {HarpCore::read_reg_generic, write_rising_edge_event_batch_size},
+        {HarpCore::read_reg_generic, HarpCore::write_to_read_only_reg_error},
+        {read_task_settings_applied_frame, HarpCore::write_to_read_only_reg_error},
+        laser_task_table_fns,
+        {HarpCore::read_reg_generic, HarpCore::write_to_read_only_reg_error},
+        {HarpCore::read_reg_generic, HarpCore::write_to_read_only_reg_error},
+        {HarpCore::read_reg_generic, HarpCore::write_to_read_only_reg_error},
+        {HarpCore::read_reg_generic, HarpCore::write_to_read_only_reg_error},
+        {HarpCore::read_reg_generic, write_fixed_frame_period},
+        {HarpCore::read_reg_generic, HarpCore::write_to_read_only_reg_error},
+        {HarpCore::read_reg_generic, write_task_frame_divisors},
+        {HarpCore::read_reg_generic, write_pipelined_exposures},
+        {HarpCore::read_reg_generic, write_acquisition_frame_count},
+        {HarpCore::read_reg_generic, HarpCore::write_to_read_only_reg_error},
+        {HarpCore::read_reg_generic, write_scheduled_start_time},
+        {HarpCore::read_reg_generic, write_trigger_mode},
+        {HarpCore::read_reg_generic, write_trigger_pin},
+        {read_trigger_latency, HarpCore::write_to_read_only_reg_error},
+        {HarpCore::read_reg_generic, HarpCore::write_to_read_only_reg_error},
+        {read_pending_command_count, HarpCore::write_to_read_only_reg_error},
+
+        ((void)ExtraTask, laser_task_fns)...,
+        ((void)ExtraPage, laser_task_table_fns)...,
+    }};
+}
+}
+
+std::array<RegSpecs, REG_COUNT>& app_reg_specs()
+{
+    static std::array<RegSpecs, REG_COUNT> specs = make_app_reg_specs(
+        std::make_index_sequence<DEFAULT_TASK_REG_COUNT>{},
+        std::make_index_sequence<EXTRA_TASK_REG_COUNT>{},
+        std::make_index_sequence<LASER_TASK_TABLE_PAGE_COUNT - 1>{});
+    return specs;
+}
+
+constinit std::array<RegFnPair, REG_COUNT> reg_handler_fns = make_reg_handler_fns(
+    std::make_index_sequence<DEFAULT_TASK_REG_COUNT>{},
+    std::make_index_sequence<EXTRA_TASK_REG_COUNT>{},
+    std::make_index_sequence<LASER_TASK_TABLE_PAGE_COUNT - 1>{});
 
 void read_reconfigure_laser_task(uint8_t address)
 {
     size_t task_index = get_fip_task_index(address);
     // Warning: if we are trying to read from a non-configured task, the
     // data is undefined (will be all zeros in this case.).
-    if ((task_index + 1) <= app_regs.LaserTaskCount)
-        app_regs.ReconfigureLaserTask[task_index] = fip_tasks[task_index].settings_;
+    if (task_table.slot_used[task_index])
+        app_regs.ReconfigureLaserTask[task_index] = task_table.tasks[task_index];
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(READ, address);
+}
+
+void read_edge_telemetry(uint8_t address)
+{
+    EdgeTelemetry telemetry;
+    edge_telemetry_snapshot.read(telemetry);
+    app_regs.EdgeCount = telemetry.edge_count;
+    app_regs.EdgeDeadlineMissCount = telemetry.deadline_miss_count;
+    // Min is undefined until the first edge.
+    app_regs.EdgeLatenessMin = telemetry.edge_count? telemetry.min_lateness_us: 0;
+    app_regs.EdgeLatenessMax = telemetry.max_lateness_us;
+    app_regs.EdgeLatenessMeanNs = telemetry.mean_lateness_ns();
+    for (size_t i = 0; i < LATENESS_HISTOGRAM_BUCKET_COUNT; ++i)
+        app_regs.EdgeLatenessHistogram[i] = telemetry.histogram[i];
     if (!HarpCore::is_muted())
         HarpCore::send_harp_reply(READ, address);
 }
 
+void read_active_schedule_backend(uint8_t address)
+{
+    app_regs.ActiveScheduleBackend
+        = active_schedule_backend.load(std::memory_order_relaxed);
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(READ, address);
+}
+
+void read_rising_edge_event_stats(uint8_t address)
+{
+    app_regs.RisingEdgeEventOverflowCount = rising_edge_event_ring.overflow_count();
+    app_regs.RisingEdgeEventHighWaterMark = rising_edge_event_ring.high_water_mark();
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(READ, address);
+}
+
+void read_trigger_latency(uint8_t address)
+{
+    app_regs.TriggerLatency[0] = trigger_latency_us.load(std::memory_order_relaxed);
+    app_regs.TriggerLatency[1] = max_trigger_latency_us.load(std::memory_order_relaxed);
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(READ, address);
+}
+
+void read_pending_command_count(uint8_t address)
+{
+    app_regs.PendingCommandCount = core1_pending_command_count();
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(READ, address);
+}
+
+void read_task_settings_applied_frame(uint8_t address)
+{
+    app_regs.TaskSettingsAppliedFrame = task_table_swap.applied_frame();
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(READ, address);
+}
+
+void read_laser_task_table(uint8_t address)
+{
+    size_t page = get_laser_task_table_page(address);
+    LaserTaskTableData& data = app_regs.LaserTaskTable[page];
+    data = LaserTaskTableData{};
+    data.task_count = task_table.task_count;
+    for (size_t i = 0; i < LASER_TASK_TABLE_PAGE_SIZE; ++i)
+    {
+        size_t task_index = page * LASER_TASK_TABLE_PAGE_SIZE + i;
+        if (task_index >= task_table.task_count)
+            break;
+        // Tasks are listed in the order they run.
+        const LaserFIPTaskSettings& settings = task_table.tasks[task_table.order[task_index]];
+        // Undo the PORT_BASE offset.
+        data.tasks[i] =
+            {uint8_t(settings.pwm_pin_bit >> PORT_BASE),
+             uint8_t(settings.output_mask >> PORT_BASE),
+             settings.events, settings.mute, settings.pwm_duty_cycle,
+             settings.pwm_frequency_hz, settings.delta1_us, settings.delta2_us,
+             settings.delta3_us, settings.delta4_us};
+    }
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(READ, address);
+}
+
+void publish_task_table()
+{
+    task_table_dirty = true;
+    // If core1 hasn't taken the last table yet, update_app() retries. Edits
+    // made in the meantime are coalesced into one swap.
+    if (task_table_swap.try_publish(task_table))
+    {
+        task_table_dirty = false;
+        hal_send_event(); // Wake core1 if it is idle.
+    }
+}
+
+void set_task_table_entry(TaskTable& table, size_t task_index,
+                          const LaserFIPTaskSettings& settings)
+{
+    table.tasks[task_index] = settings;
+    table.pwm[task_index] = LaserPWMConfig::resolve(
+        settings.pwm_duty_cycle, settings.pwm_frequency_hz, clock_get_hz(clk_sys));
+}
+
+bool commit_task_table_edit()
+{
+    // Free slots run in every frame once a task fills them.
+    for (size_t i = 0; i < MAX_TASK_COUNT; ++i)
+    {
+        if (!edited_task_table.slot_used[i])
+            edited_task_table.frame_divisors[i] = TaskFrameDivisor();
+    }
+    app_regs.TaskScheduleError = check_schedule(edited_task_table);
+    // The trigger input can't also be a task output.
+    if ((app_regs.TriggerMode != TRIGGER_NONE)
+        && (task_output_pins(edited_task_table) & trigger_pin_bit(app_regs.TriggerPin)))
+        app_regs.TaskScheduleError = SCHEDULE_PIN_CONFLICT;
+    // A triggered frame needs an edge to start from.
+    if ((app_regs.TaskScheduleError == SCHEDULE_OK)
+        && (app_regs.TriggerMode == TRIGGER_EACH_FRAME)
+        && edited_task_table.task_count && has_empty_frame(edited_task_table))
+        app_regs.TaskScheduleError = SCHEDULE_EMPTY_FRAME;
+    if (app_regs.TaskScheduleError != SCHEDULE_OK)
+        return false;
+    task_table = edited_task_table;
+    for (size_t i = 0; i < MAX_TASK_COUNT; ++i)
+    {
+        app_regs.ReconfigureLaserTask[i] = task_table.slot_used[i]?
+            task_table.tasks[i]: LaserFIPTaskSettings();
+        app_regs.TaskFrameDivisors[i] = task_table.frame_divisors[i];
+        app_regs.LaserTaskOrder[i] = (i < task_table.task_count)?
+            task_table.order[i]: NO_TASK_SLOT;
+    }
+    app_regs.LaserTaskCount = task_table.task_count;
+    app_regs.FixedFramePeriod = task_table.fixed_frame_period_us;
+    app_regs.PipelinedExposures = task_table.pipelined_exposures;
+    update_schedule_prediction();
+    publish_task_table();
+    return true;
+}
+
+void update_schedule_prediction()
+{
+    // Frames may differ in length. Report their mean over a frame cycle.
+    uint32_t cycle_length = frame_cycle_length(task_table);
+    uint32_t cycle_period_us = frame_cycle_period_us(task_table);
+    app_regs.PredictedFramePeriod = (cycle_period_us + cycle_length / 2) / cycle_length;
+    app_regs.PredictedFrameRate = cycle_period_us?
+        float(cycle_length) * 1e6f / float(cycle_period_us): 0;
+    // Idle time padded onto the end of the busiest frame.
+    app_regs.FramePeriodSlack = 0;
+    if (task_table.fixed_frame_period_us && task_table.task_count)
+    {
+        uint64_t busiest_frame_us = 0;
+        for (uint32_t frame = 0; frame < cycle_length; ++frame)
+            busiest_frame_us = std::max(busiest_frame_us,
+                                        frame_task_time_us(task_table, frame));
+        app_regs.FramePeriodSlack = task_table.fixed_frame_period_us - busiest_frame_us;
+    }
+    for (size_t io = 0; io < IO_PIN_COUNT; ++io)
+    {
+        app_regs.PredictedLaserDutyCycle[io]
+            = laser_duty_fraction(task_table, 1u << (io + PORT_BASE));
+    }
+}
+
 bool set_task_schedule_state(bool state)
 {
     // Push enable/disable signal to core1.
-    bool success = queue_try_add(&enable_task_schedule_queue, &state);
+    bool success = send_core1_command(Core1Command::enable(state));
+    if (success && state)
+        last_enable_sequence = core1_command_sequence;
     // Harp register should represent the actual state of the task schedule.
     app_regs.EnableTaskSchedule = uint8_t(state);
     return success;
@@ -61,6 +342,13 @@ bool set_task_schedule_state(bool state)
 
 void write_enable_task_schedule(msg_t& msg)
 {
+    uint8_t state = *reinterpret_cast<uint8_t*>(msg.payload);
+    // Emit error if a finite acquisition has no tasks to run its frames.
+    if (state && app_regs.AcquisitionFrameCount && !task_table.task_count)
+    {
+        HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
     HarpCore::copy_msg_payload_to_register(msg);
     bool success = set_task_schedule_state(bool(app_regs.EnableTaskSchedule));
     if (HarpCore::is_muted())
@@ -93,15 +381,16 @@ void write_add_laser_task(msg_t& msg)
     settings_ptr->pwm_pin_bit = settings_ptr->pwm_pin_bit << PORT_BASE;
     settings_ptr->output_mask = settings_ptr->output_mask << PORT_BASE;
 
-    // Push the task settings to core1.
-    if (!queue_try_add(&add_task_queue, settings_ptr))
+    // The new task takes the lowest free slot and runs after the others.
+    edited_task_table = task_table;
+    size_t task_index = add_task_slot(edited_task_table);
+    set_task_table_entry(edited_task_table, task_index, *settings_ptr);
+    // Emit error if the new task doesn't fit in the schedule.
+    if (!commit_task_table_edit())
     {
-        // Handle queue full error.
         HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
         return;
     }
-
-    ++app_regs.LaserTaskCount;
     if (!HarpCore::is_muted())
         HarpCore::send_harp_reply(WRITE, msg.header.address);
 }
@@ -112,120 +401,435 @@ void write_remove_laser_task(msg_t& msg)
     size_t task_index = app_regs.RemoveLaserTask;
 
     // Emit error if schedule is running or task does not exist.
-    if (app_regs.EnableTaskSchedule || 
-        ((task_index + 1 ) > app_regs.LaserTaskCount || (task_index >= MAX_TASK_COUNT)))
+    if (app_regs.EnableTaskSchedule || (task_index >= MAX_TASK_COUNT)
+        || !task_table.slot_used[task_index])
     {
         HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
         return;
     }
 
-    // push remove-by-index signal to core1.
-    if (!queue_try_add(&remove_task_queue, &task_index))
+    // Free the task's slot. The other tasks keep theirs.
+    edited_task_table = task_table;
+    remove_task_slot(edited_task_table, task_index);
+    // Emit error if the tasks left behind don't form a valid schedule (i.e:
+    // two exposures of the same camera end up back to back).
+    if (!commit_task_table_edit())
     {
-        // Handle queue full error.
         HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
         return;
     }
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(WRITE, msg.header.address);
+}
 
-    // Remove the task from the app_regs and shift all tasks down by one.
-    for (size_t i = task_index; i < (MAX_TASK_COUNT - 1); ++i)
+void write_remove_all_laser_tasks(msg_t& msg)
+{
+    // Emit error if schedule is running. Without tasks its frames would
+    // last 0us (or only the fixed period), and core1 would keep counting
+    // frames with no outputs; disable the schedule first.
+    if (app_regs.EnableTaskSchedule)
+    {
+        HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    HarpCore::copy_msg_payload_to_register(msg);
+    if (!app_regs.RemoveAllLaserTasks)
     {
-        app_regs.ReconfigureLaserTask[i] = app_regs.ReconfigureLaserTask[i + 1];
+        if (!HarpCore::is_muted())
+            HarpCore::send_harp_reply(WRITE, msg.header.address);
+        return;
     }
 
-    --app_regs.LaserTaskCount;
+    // An empty schedule is always valid.
+    edited_task_table = task_table;
+    clear_task_slots(edited_task_table);
+    commit_task_table_edit();
     if (!HarpCore::is_muted())
         HarpCore::send_harp_reply(WRITE, msg.header.address);
 }
 
-void write_remove_all_laser_tasks(msg_t& msg)
+void write_reconfigure_laser_task(msg_t& msg)
 {
+    size_t task_index = get_fip_task_index(msg);
+    // Tasks can be reconfigured while the schedule runs. core1 swaps the new
+    // settings in at the next frame boundary.
+    // Emit Write Error if this task does not yet exist in the queue.
+    if (!task_table.slot_used[task_index])
+    {
+        HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
     HarpCore::copy_msg_payload_to_register(msg);
-    // push remove-all signal to core1.
-    if (!queue_try_add(&clear_tasks_queue, &app_regs.RemoveAllLaserTasks))
+    LaserFIPTaskSettings* settings_ptr
+        = reinterpret_cast<LaserFIPTaskSettings*>(msg.payload);
+    // Emit error if pwm_pin_bit is specified wrong (more than 1 or none).
+    if (std::popcount(settings_ptr->pwm_pin_bit) != 1)
+    {
+        HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    // Source is one-hot encoded and refers to pins in a range from 0 through 7.
+    // PCB "IO0" = GPIO0 + PORT_BASE. Do offset.
+    settings_ptr->pwm_pin_bit = settings_ptr->pwm_pin_bit << PORT_BASE;
+    settings_ptr->output_mask = settings_ptr->output_mask << PORT_BASE;
+
+    edited_task_table = task_table;
+    set_task_table_entry(edited_task_table, task_index, *settings_ptr);
+    // Emit error if the new settings don't fit in the schedule.
+    if (!commit_task_table_edit())
+    {
+        HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(WRITE, msg.header.address);
+}
+
+void write_laser_task_table(msg_t& msg)
+{
+    size_t page = get_laser_task_table_page(msg.header.address);
+    const LaserTaskTableData& data
+        = *reinterpret_cast<LaserTaskTableData*>(msg.payload);
+    size_t first_task_index = page * LASER_TASK_TABLE_PAGE_SIZE;
+    // Emit error if there are too many tasks, or none while the schedule runs
+    // (like RemoveAllLaserTasks, it would leave core1 counting frames with no
+    // outputs), or the page is past the end of the table.
+    bool valid = (data.task_count <= MAX_TASK_COUNT)
+        && !(app_regs.EnableTaskSchedule && (data.task_count == 0))
+        && ((page == 0) || (first_task_index < data.task_count));
+    // Emit error if a later page doesn't continue the table being staged.
+    if (page > 0)
+        valid = valid && (staged_laser_task_table_pages == page)
+                && (staged_laser_task_table[0].task_count == data.task_count);
+    // Emit error if any pwm_pin_bit is specified wrong (more than 1 or none).
+    for (size_t i = 0; valid && (i < LASER_TASK_TABLE_PAGE_SIZE)
+                       && (first_task_index + i < data.task_count); ++i)
+        valid = (std::popcount(data.tasks[i].pwm_pin_bit) == 1);
+    if (!valid)
+    {
+        staged_laser_task_table_pages = 0;
+        HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    HarpCore::copy_msg_payload_to_register(msg);
+    staged_laser_task_table[page] = data;
+    staged_laser_task_table_pages = page + 1;
+    // Wait for the rest of a table longer than this page.
+    if (first_task_index + LASER_TASK_TABLE_PAGE_SIZE < data.task_count)
+    {
+        if (!HarpCore::is_muted())
+            HarpCore::send_harp_reply(WRITE, msg.header.address);
+        return;
+    }
+    staged_laser_task_table_pages = 0;
+
+    // The table's tasks take slots 0 up, in the order listed.
+    edited_task_table = task_table;
+    clear_task_slots(edited_task_table);
+    for (size_t i = 0; i < data.task_count; ++i)
+    {
+        const LaserTaskTableEntry& entry = staged_laser_task_table
+            [i / LASER_TASK_TABLE_PAGE_SIZE].tasks[i % LASER_TASK_TABLE_PAGE_SIZE];
+        // Source refers to IO pins. PCB "IO0" = GPIO0 + PORT_BASE. Do offset.
+        set_task_table_entry(edited_task_table, add_task_slot(edited_task_table),
+            {uint32_t(entry.pwm_pin_bit) << PORT_BASE, entry.pwm_duty_cycle,
+             entry.pwm_frequency_hz, uint32_t(entry.output_mask) << PORT_BASE,
+             entry.events, entry.mute, entry.delta1_us, entry.delta2_us,
+             entry.delta3_us, entry.delta4_us});
+    }
+    // Emit error if the tasks don't form a valid schedule. Otherwise, hand the
+    // whole table to core1 in one transfer.
+    if (!commit_task_table_edit())
+    {
+        HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(WRITE, msg.header.address);
+}
+
+void write_schedule_backend(msg_t& msg)
+{
+    uint8_t backend = *reinterpret_cast<uint8_t*>(msg.payload);
+    // Emit error if schedule is running or the backend does not exist.
+    if (app_regs.EnableTaskSchedule || (backend >= SCHEDULE_BACKEND_COUNT))
+    {
+        HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    // Push the backend selection to core1. It applies on the next enable.
+    if (!send_core1_command(Core1Command::backend(backend)))
     {
         // Handle queue full error.
         HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
         return;
     }
+    HarpCore::copy_msg_payload_to_register(msg);
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(WRITE, msg.header.address);
+}
+
+void write_rising_edge_event_batch_size(msg_t& msg)
+{
+    uint8_t batch_size = *reinterpret_cast<uint8_t*>(msg.payload);
+    if (batch_size > RISING_EDGE_EVENT_BATCH_CAPACITY)
+    {
+        HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    HarpCore::copy_msg_payload_to_register(msg);
+    // Don't hold back events batched under the old size.
+    if (rising_edge_event_batch.count())
+        send_rising_edge_event_batch();
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(WRITE, msg.header.address);
+}
 
-    // Clear the app_regs.
+void write_fixed_frame_period(msg_t& msg)
+{
+    edited_task_table = task_table;
+    edited_task_table.fixed_frame_period_us = *reinterpret_cast<uint32_t*>(msg.payload);
+    // Emit error if the tasks don't fit in the period.
+    if (!commit_task_table_edit())
+    {
+        HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(WRITE, msg.header.address);
+}
+
+void write_task_frame_divisors(msg_t& msg)
+{
+    edited_task_table = task_table;
+    const TaskFrameDivisor* frame_divisors
+        = reinterpret_cast<TaskFrameDivisor*>(msg.payload);
     for (size_t i = 0; i < MAX_TASK_COUNT; ++i)
     {
-        app_regs.ReconfigureLaserTask[i] = LaserFIPTaskSettings();
+        if (edited_task_table.slot_used[i])
+            edited_task_table.frame_divisors[i] = frame_divisors[i];
     }
+    // Emit error if a phase is past its divisor, the frames don't repeat
+    // within MAX_CYCLE_FRAME_COUNT, or a frame ends up empty.
+    if (!commit_task_table_edit())
+    {
+        HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(WRITE, msg.header.address);
+}
 
-    app_regs.LaserTaskCount = 0;
+void write_pipelined_exposures(msg_t& msg)
+{
+    edited_task_table = task_table;
+    edited_task_table.pipelined_exposures = (*reinterpret_cast<uint8_t*>(msg.payload) != 0);
+    // Emit error if the frames the tasks form aren't valid.
+    if (!commit_task_table_edit())
+    {
+        HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
     if (!HarpCore::is_muted())
         HarpCore::send_harp_reply(WRITE, msg.header.address);
 }
 
-void write_reconfigure_laser_task(msg_t& msg)
+void write_acquisition_frame_count(msg_t& msg)
 {
-    size_t task_index = get_fip_task_index(msg);
+    uint32_t frame_count = *reinterpret_cast<uint32_t*>(msg.payload);
     // Emit error if schedule is running.
     if (app_regs.EnableTaskSchedule)
     {
         HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
         return;
     }
-    // Emit Write Error if this task does not yet exist in the queue.
-    if ((task_index + 1) > app_regs.LaserTaskCount)
+    // Push the acquisition length to core1. It applies on the next enable.
+    if (!send_core1_command(Core1Command::acquisition_frame_count(frame_count)))
     {
         HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
         return;
     }
     HarpCore::copy_msg_payload_to_register(msg);
-    LaserFIPTaskSettings* settings_ptr
-        = reinterpret_cast<LaserFIPTaskSettings*>(msg.payload);
-    // Emit error if pwm_pin_bit is specified wrong (more than 1 or none).
-    if (std::popcount(settings_ptr->pwm_pin_bit) != 1)
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(WRITE, msg.header.address);
+}
+
+void write_scheduled_start_time(msg_t& msg)
+{
+    uint64_t harp_time_us = *reinterpret_cast<uint64_t*>(msg.payload);
+    // Convert through the synchronizer so that every board on the same Harp
+    // clock starts on the same tick.
+    uint64_t start_us = HarpCore::harp_to_system_us_64(harp_time_us);
+    uint64_t now_us = time_us_64();
+    // Emit error if schedule is running, the start time is out of range, or
+    // a finite acquisition has no tasks to run its frames.
+    if (app_regs.EnableTaskSchedule || (start_us <= now_us)
+        || (start_us - now_us > MAX_SCHEDULED_START_LEAD_US)
+        || (app_regs.AcquisitionFrameCount && !task_table.task_count))
     {
         HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
         return;
     }
-    // Source is one-hot encoded and refers to pins in a range from 0 through 7.
-    // PCB "IO0" = GPIO0 + PORT_BASE. Do offset.
-    settings_ptr->pwm_pin_bit = settings_ptr->pwm_pin_bit << PORT_BASE;
-    settings_ptr->output_mask = settings_ptr->output_mask << PORT_BASE;
+    // core1 enables the schedule and starts it at start_us in one command.
+    if (!send_core1_command(Core1Command::start_at(uint32_t(start_us))))
+    {
+        HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    last_enable_sequence = core1_command_sequence;
+    app_regs.EnableTaskSchedule = 1;
+    HarpCore::copy_msg_payload_to_register(msg);
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(WRITE, msg.header.address);
+}
 
-    ReconfigureTaskData task_data = {task_index, *settings_ptr};
+bool set_trigger_config(uint8_t mode, uint8_t io_pin_bit)
+{
+    TriggerConfig config{mode, uint8_t(std::countr_zero(io_pin_bit) + PORT_BASE)};
+    if (!send_core1_command(Core1Command::trigger(config)))
+        return false;
+    // Bus switches set HIGH drive out.
+    uint32_t input_mask = (mode != TRIGGER_NONE)? io_pin_bit: 0;
+    gpio_put_masked(0x000000FF << PORT_DIR_BASE, ~(input_mask << PORT_DIR_BASE));
+    return true;
+}
 
-    // Push reconfigured task data to core1.
-    if (!queue_try_add(&reconfigure_task_queue, &task_data))
+void write_trigger_mode(msg_t& msg)
+{
+    uint8_t mode = *reinterpret_cast<uint8_t*>(msg.payload);
+    // Emit error if schedule is running, the mode does not exist, there is
+    // no trigger pin to trigger from, a task uses the trigger pin (tasks
+    // may, while there is no trigger), or a frame to trigger has no tasks.
+    if (app_regs.EnableTaskSchedule || (mode >= TRIGGER_MODE_COUNT)
+        || ((mode != TRIGGER_NONE) && !app_regs.TriggerPin)
+        || ((mode != TRIGGER_NONE)
+            && (task_output_pins(task_table) & trigger_pin_bit(app_regs.TriggerPin)))
+        || ((mode == TRIGGER_EACH_FRAME) && task_table.task_count
+            && has_empty_frame(task_table))
+        || !set_trigger_config(mode, app_regs.TriggerPin))
     {
-        // Handle queue full error.
         HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
         return;
     }
+    HarpCore::copy_msg_payload_to_register(msg);
+    if (!HarpCore::is_muted())
+        HarpCore::send_harp_reply(WRITE, msg.header.address);
+}
 
+void write_trigger_pin(msg_t& msg)
+{
+    uint8_t io_pin_bit = *reinterpret_cast<uint8_t*>(msg.payload);
+    // Emit error if schedule is running, the pin isn't one IO pin, or a task
+    // uses it.
+    if (app_regs.EnableTaskSchedule || (std::popcount(io_pin_bit) != 1)
+        || (task_output_pins(task_table) & trigger_pin_bit(io_pin_bit))
+        || !set_trigger_config(app_regs.TriggerMode, io_pin_bit))
+    {
+        HarpCore::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    HarpCore::copy_msg_payload_to_register(msg);
     if (!HarpCore::is_muted())
         HarpCore::send_harp_reply(WRITE, msg.header.address);
 }
 
-void update_app()
+void send_rising_edge_event_batch()
 {
-    // Receive msgs from core1 with state/timings.
-    if (!queue_is_empty(&rising_edge_event_queue))
+    for (size_t i = 0; i < EventBatch::word_count(); ++i)
+        app_regs.RisingEdgeEventBatch[i] = rising_edge_event_batch.words()[i];
+    HarpCore::send_harp_reply(EVENT, AppRegNum::RisingEdgeEventBatch,
+        HarpCore::system_to_harp_us_64(rising_edge_event_batch.first_time_us()));
+    rising_edge_event_batch.clear();
+}
+
+void send_rising_edge_events()
+{
+    RisingEdgeEventData event_data;
+    // Drain everything so core0 never falls behind core1.
+    while (rising_edge_event_ring.try_pop(event_data))
     {
-        // Retrieve the rising edge event data from the queue.
-        RisingEdgeEventData event_data;
-        queue_remove_blocking(&rising_edge_event_queue, &event_data);
         // Offset to account for the GPIO to IO mapping.
-        app_regs.RisingEdgeEvent = uint8_t(event_data.output_state >> PORT_BASE);
-        //  Send them back over Harp Protocol with a Harp clock domain timestamp.
-        HarpCore::send_harp_reply(EVENT, AppRegNum::RisingEdgeEvent,
-                                  HarpCore::system_to_harp_us_64(event_data.time_us));
+        uint8_t port_state = uint8_t(event_data.output_state >> PORT_BASE);
+        // Read the time after the pop so that it's never older than the event.
+        uint64_t time_us = unwrap_time_us(event_data.time_us, time_us_64());
+        if (app_regs.RisingEdgeEventBatchSize == 0)
+        {
+            app_regs.RisingEdgeEvent = port_state;
+            //  Send them back over Harp Protocol with a Harp clock domain timestamp.
+            HarpCore::send_harp_reply(EVENT, AppRegNum::RisingEdgeEvent,
+                                      HarpCore::system_to_harp_us_64(time_us));
+            continue;
+        }
+        if (!rising_edge_event_batch.add(port_state, time_us))
+        {
+            send_rising_edge_event_batch();
+            rising_edge_event_batch.add(port_state, time_us);
+        }
+        if (rising_edge_event_batch.count() >= app_regs.RisingEdgeEventBatchSize)
+            send_rising_edge_event_batch();
+    }
+    // Don't hold a partial batch back indefinitely (i.e: after the schedule
+    // is disabled).
+    if (rising_edge_event_batch.count()
+        && (time_us_64() - rising_edge_event_batch.first_time_us()
+            >= RISING_EDGE_EVENT_BATCH_TIMEOUT_US))
+        send_rising_edge_event_batch();
+}
+
+void send_acquisition_end_events()
+{
+    AcquisitionEndData end_data;
+    while (acquisition_end_ring.try_pop(end_data))
+    {
+        // core1 pushed the acquisition's last edges before its end.
+        send_rising_edge_events();
+        if (rising_edge_event_batch.count())
+            send_rising_edge_event_batch();
+        // core1 has stopped on its own, unless the host enabled the schedule
+        // again after it did.
+        if (end_data.enable_sequence == last_enable_sequence)
+            app_regs.EnableTaskSchedule = 0;
+        app_regs.AcquisitionComplete = end_data.frame_count;
+        uint64_t time_us = unwrap_time_us(end_data.time_us, time_us_64());
+        HarpCore::send_harp_reply(EVENT, AppRegNum::AcquisitionComplete,
+                                  HarpCore::system_to_harp_us_64(time_us));
     }
+}
+
+void update_app()
+{
+    // Receive msgs from core1 with state/timings.
+    send_rising_edge_events();
+    send_acquisition_end_events();
+    // Publish task edits core1 wasn't ready for.
+    if (task_table_dirty)
+        publish_task_table();
     // Disable output waveforms if we've disconnected com ports (safety feature).
-    if (HarpCore::get_op_mode() != ACTIVE)
-        set_task_schedule_state(false);
+    // The doorbell stops core1 mid-frame instead of after the current frame.
+    if ((HarpCore::get_op_mode() != ACTIVE) && app_regs.EnableTaskSchedule)
+    {
+        send_core1_abort();
+        app_regs.EnableTaskSchedule = 0;
+    }
 }
 
 void reset_app()
 {
+    // Stop the schedule before core1 applies the settings below.
+    set_task_schedule_state(false);
     // Clear all settings configurations to all zero.
-    app_regs.LaserTaskCount = 0;
+    edited_task_table = TaskTable{};
+    commit_task_table_edit();
+    app_regs.ScheduleBackend = CPU_BACKEND;
+    app_regs.RisingEdgeEventBatchSize = 0;
+    rising_edge_event_batch.clear();
+    send_core1_command(Core1Command::backend(app_regs.ScheduleBackend));
+    app_regs.AcquisitionFrameCount = 0;
+    send_core1_command(Core1Command::acquisition_frame_count(0));
+    app_regs.TriggerMode = TRIGGER_NONE;
+    app_regs.TriggerPin = 0;
+    set_trigger_config(TRIGGER_NONE, 0);
     // Configure bus switches for software control of the BNC connectors.
     // Init bus switch pins.
     gpio_init_mask((0x000000FF << PORT_DIR_BASE));
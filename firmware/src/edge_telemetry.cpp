@@ -0,0 +1,35 @@
+#include <edge_telemetry.h>
+
+void EdgeTelemetry::clear()
+{
+    *this = EdgeTelemetry{};
+    min_lateness_us = UINT32_MAX;
+}
+
+uint32_t EdgeTelemetry::mean_lateness_ns() const
+{
+    if (edge_count == 0)
+        return 0;
+    return uint32_t((total_lateness_us * 1000) / edge_count);
+}
+
+void EdgeTelemetrySnapshot::publish(const EdgeTelemetry& telemetry)
+{
+    uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    data_ = telemetry;
+    std::atomic_thread_fence(std::memory_order_release);
+    sequence_.store(sequence + 2, std::memory_order_relaxed);
+}
+
+void EdgeTelemetrySnapshot::read(EdgeTelemetry& telemetry) const
+{
+    uint32_t sequence;
+    do
+    {
+        sequence = sequence_.load(std::memory_order_acquire);
+        telemetry = data_;
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((sequence & 1u) || (sequence != sequence_.load(std::memory_order_relaxed)));
+}
@@ -1,179 +1,596 @@
-#include <harp_core.h>
+#include <algorithm>
 #include <fip_schedule.h>
 #include <fip_ctrl_queues.h>
-#include <hardware/structs/timer.h>
 
-etl::vector<LaserFIPTask, MAX_TASK_COUNT> fip_tasks;
+std::optional<LaserFIPTask> fip_tasks[MAX_TASK_COUNT]; // by task slot.
+uint8_t fip_task_order[MAX_TASK_COUNT]; // slots of the tasks, in the order they run.
+size_t fip_task_count = 0;
+FIPTimeline fip_timeline;
+uint32_t fixed_frame_period_us = 0; // 0: each frame lasts as long as its tasks.
+TaskFrameDivisor fip_task_frame_divisors[MAX_TASK_COUNT]; // by task slot.
+uint32_t frame_cycle_frame_count = 1; // frames in fip_timeline.
+uint32_t acquisition_frame_count = 0; // 0: run until disabled.
 
 bool enabled = false;
+uint32_t session_enable_sequence = 0; // last enable command of this session.
+bool start_pending = false; // enabled, but waiting for scheduled_start_us.
+uint32_t scheduled_start_us = 0;
+uint32_t pwm_state = 0; // laser pins currently connected to their PWM.
+uint32_t frame_start_us = 0;
+uint32_t frame_count = 0;
+EdgeTelemetry edge_telemetry;
+EdgeTelemetrySnapshot edge_telemetry_snapshot;
+uint8_t schedule_backend = CPU_BACKEND;
+std::atomic<uint8_t> active_schedule_backend{CPU_BACKEND};
+std::atomic<uint32_t> core1_command_ack{0};
+uint32_t abort_sequence = 0; // doorbell sequence of the last abort.
+PIOEdgeTable pio_edge_table;
+PIOEdgeEngine pio_edge_engine;
+size_t next_edge_index = 0; // timer IRQ backend: next edge the alarm writes.
+bool edge_alarm_initialized = false;
+TriggerConfig trigger_config{TRIGGER_NONE, 0};
+volatile bool awaiting_trigger = false; // the next frame starts on a trigger.
+volatile bool cycle_change_pending = false; // timer IRQ backend: see on_edge_alarm().
+uint32_t trigger_time_us = 0;
+bool trigger_latency_pending = false; // the frame's first edge is still due.
+std::atomic<uint32_t> trigger_latency_us{0};
+std::atomic<uint32_t> max_trigger_latency_us{0};
 
-/// \warning: this fn should not be called inside an interrupt.
-inline uint64_t time_us_64_unsafe()
+void update_commands()
 {
-    uint64_t time = timer_hw->timelr; // Locks time until we read TIMEHR.
-    return (uint64_t(timer_hw->timehr) << 32) | time;
-}
-
-inline uint32_t time_us_32_fast()
-{return timer_hw->timerawl;}
-
-void sleep_us(uint32_t us)
-{
-    uint32_t start_time_us = timer_hw->timerawl;
-    while (int32_t(timer_hw->timerawl - start_time_us) < us)
-        tight_loop_contents();
+    Core1Command command;
+    while (queue_try_remove(&core1_command_queue, &command))
+    {
+        // core0 rang the doorbell before it sent this command, so the abort
+        // comes first.
+        if (hal_doorbell_rung()
+            && (int32_t(command.sequence - hal_doorbell_sequence()) >= 0))
+            update_abort_state();
+        // Enables sent before the last abort don't undo it.
+        bool enables = (command.type == CMD_START_SCHEDULE_AT)
+                       || ((command.type == CMD_ENABLE_SCHEDULE) && command.value);
+        if (!enables || (int32_t(command.sequence - abort_sequence) >= 0))
+            apply_command(command);
+        core1_command_ack.store(command.sequence, std::memory_order_release);
+    }
 }
 
-void update_enabled_state()
+void apply_command(const Core1Command& command)
 {
-    // Update enabled state.
-    if (!queue_is_empty(&enable_task_schedule_queue))
+    switch (command.type)
     {
-        uint8_t enable_state;
-
-        if (queue_try_remove(&enable_task_schedule_queue, &enable_state))
-        {
-            // Update the enabled state based on the message.
-            if (enable_state)
+        case CMD_ENABLE_SCHEDULE:
+            // An enable for a running session (i.e: sent before core0 saw it
+            // end) belongs to it.
+            if (command.value)
+                session_enable_sequence = command.sequence;
+            if (command.value && !enabled)
+            {
+                // Tasks published before the enable apply from the first
+                // frame. They only change between frames from here on.
+                apply_task_table(0);
+                start_sequence();
                 enabled = true;
-            else
+            }
+            else if (!command.value && enabled)
+            {
+                stop_sequence();
                 enabled = false;
-        }
+            }
+            break;
+        case CMD_START_SCHEDULE_AT:
+            if (enabled)
+                break;
+            // run_once() starts it, so that commands still apply meanwhile.
+            session_enable_sequence = command.sequence;
+            scheduled_start_us = command.value;
+            start_pending = true;
+            enabled = true;
+            break;
+        case CMD_SCHEDULE_BACKEND:
+            schedule_backend = uint8_t(command.value);
+            break;
+        case CMD_ACQUISITION_FRAME_COUNT:
+            acquisition_frame_count = command.value;
+            break;
+        case CMD_TRIGGER_CONFIG:
+            apply_trigger_config(command.trigger_config);
+            break;
     }
 }
 
-void update_fip_tasks()
+bool update_abort_state()
 {
-    LaserFIPTaskSettings task_settings;
+    if (!hal_doorbell_rung())
+        return false;
+    // Read the ring before stopping so that a ring during the stop isn't
+    // answered along with it.
+    uint32_t doorbell_sequence = hal_doorbell_sequence();
+    stop_sequence();
+    hal_doorbell_answer(doorbell_sequence);
+    abort_sequence = doorbell_sequence;
+    enabled = false;
+    return true;
+}
 
-    // Check if there are messages in the add task queue.
-    while (!queue_is_empty(&add_task_queue))
+bool apply_task_table(uint32_t frame_index)
+{
+    const TaskTable* table = task_table_swap.pending();
+    if (!table)
+        return false;
+    // Only touch the hardware that changed so that the other lasers' PWM
+    // slices are left running undisturbed. Tasks keep their slots, so
+    // removing one leaves the others in place.
+    for (size_t slot = 0; slot < MAX_TASK_COUNT; ++slot)
     {
-        // Retrieve the task settings from the queue.
-        if (queue_try_remove(&add_task_queue, &task_settings) && fip_tasks.size() < MAX_TASK_COUNT)
+        if (!table->slot_used[slot])
         {
-            // Add the task to the fip_tasks vector.
-            fip_tasks.emplace_back(
-                LaserFIPTaskSettings::onehot_to_pin(task_settings.pwm_pin_bit),
-                task_settings.pwm_duty_cycle,
-                task_settings.pwm_frequency_hz,
-                task_settings.output_mask,
-                task_settings.events,
-                task_settings.mute,
-                task_settings.delta1_us,
-                task_settings.delta2_us,
-                task_settings.delta3_us,
-                task_settings.delta4_us);
+            fip_tasks[slot].reset();
+            continue;
         }
+        const LaserFIPTaskSettings& settings = table->tasks[slot];
+        const LaserPWMConfig& pwm = table->pwm[slot];
+        if (!fip_tasks[slot])
+            fip_tasks[slot].emplace(settings, pwm);
+        else
+            fip_tasks[slot]->apply_settings(settings, pwm);
+        fip_task_frame_divisors[slot] = table->frame_divisors[slot];
     }
+    fip_task_count = table->task_count;
+    std::copy(table->order, table->order + table->task_count, fip_task_order);
+    fixed_frame_period_us = table->fixed_frame_period_us;
+    fip_timeline.set_pipelined(table->pipelined_exposures);
+    // core0 only publishes tables whose frames repeat within
+    // MAX_CYCLE_FRAME_COUNT.
+    frame_cycle_frame_count = frame_cycle_length(*table);
+    if (frame_cycle_frame_count == 0)
+        frame_cycle_frame_count = 1;
+    task_table_swap.release(frame_index);
+    compile_fip_timeline(frame_index);
+    return true;
+}
 
-    // Check if there are messages in the remove task queue.
-    uint8_t task_index;
-    while (!queue_is_empty(&remove_task_queue))
+void compile_fip_timeline(uint32_t first_frame_index)
+{
+    fip_timeline.clear();
+    // A finite acquisition may end partway through a cycle.
+    uint32_t frames = frame_cycle_frame_count;
+    // Triggered frames start one at a time.
+    if (trigger_config.mode == TRIGGER_EACH_FRAME)
+        frames = 1;
+    if (acquisition_frame_count && (acquisition_frame_count > first_frame_index)
+        && (acquisition_frame_count - first_frame_index < frames))
+        frames = acquisition_frame_count - first_frame_index;
+    for (uint32_t frame = 0; frame < frames; ++frame)
     {
-        // Retrieve the task index from the queue.
-        if (queue_try_remove(&remove_task_queue, &task_index))
+        for (size_t i = 0; i < fip_task_count; ++i)
         {
-            // Remove the task from the fip_tasks vector.
-            if (task_index < fip_tasks.size())
-            {
-                fip_tasks.erase(fip_tasks.begin() + task_index);
-            }
+            size_t slot = fip_task_order[i];
+            if (fip_task_frame_divisors[slot].runs_in_frame(first_frame_index + frame))
+                fip_timeline.append_task(fip_tasks[slot]->settings_);
         }
+        // core0 only publishes tasks that fit in the fixed frame period.
+        fip_timeline.end_frame(fixed_frame_period_us);
     }
+}
+
+void apply_trigger_config(const TriggerConfig& config)
+{
+    if (trigger_config.mode != TRIGGER_NONE)
+        hal_trigger_deinit(trigger_config.pin);
+    trigger_config = config;
+    if (trigger_config.mode != TRIGGER_NONE)
+        hal_trigger_init(trigger_config.pin, on_trigger);
+}
+
+bool next_cycle_differs()
+{
+    // Frame-triggered timelines hold one frame of the frame cycle.
+    if ((trigger_config.mode == TRIGGER_EACH_FRAME) && (frame_cycle_frame_count > 1))
+        return true;
+    return acquisition_frame_count
+           && (acquisition_frame_count - frame_count < fip_timeline.frame_count());
+}
+
+bool prepare_next_cycle()
+{
+    if (apply_task_table(frame_count))
+        return true;
+    if (!next_cycle_differs())
+        return false;
+    compile_fip_timeline(frame_count);
+    return true;
+}
 
-    // Check if there are messages in the clear tasks queue.
-    bool clear_all;
-    if (!queue_is_empty(&clear_tasks_queue))
+void end_acquisition()
+{
+    // Stop before the PIO starts the next frame on its own.
+    stop_sequence();
+    enabled = false;
+    hal_busy_wait_until_us_32(frame_start_us);
+    acquisition_end_ring.try_push({frame_count, frame_start_us,
+                                   session_enable_sequence});
+}
+
+bool load_pio_edge_engine()
+{
+    LaserPWMTiming pwm_timings[MAX_TASK_COUNT];
+    size_t pwm_timing_count = 0;
+    for (size_t i = 0; i < fip_task_count; ++i)
     {
-        // Retrieve the clear signal from the queue.
-        if (queue_try_remove(&clear_tasks_queue, &clear_all))
-        {
-            if (clear_all)
-            {
-                // Clear all tasks from the fip_tasks vector.
-                fip_tasks.clear();
-            }
-        }
+        const LaserFIPTask& fip_task = *fip_tasks[fip_task_order[i]];
+        pwm_timings[pwm_timing_count++] = LaserPWMTiming::from_config(
+            fip_task.settings_.pwm_pin_bit, fip_task.pwm_);
     }
+    if (!pio_edge_table.encode(fip_timeline, pwm_timings, pwm_timing_count,
+                               hal_cycles_per_us()))
+        return false;
+    pio_edge_engine.load(pio_edge_table);
+    return true;
+}
 
-    // Check if there are messages in the reconfigure task queue.
-    ReconfigureTaskData task_data{};
-    while (!queue_is_empty(&reconfigure_task_queue))
-    {
-        // Retrieve the task settings from the queue.
-        if (queue_try_remove(&reconfigure_task_queue, &task_data))
-        {
-            size_t task_index = task_data.task_index;
-            LaserFIPTaskSettings task_settings = task_data.settings;
+void start_sequence()
+{
+    start_sequence_at(hal_time_us_32());
+}
 
-            if (task_index < fip_tasks.size())
-            {
-                // Reconfigure the task in the fip_tasks vector.
-                fip_tasks[task_index] = LaserFIPTask(
-                    LaserFIPTaskSettings::onehot_to_pin(task_settings.pwm_pin_bit),
-                    task_settings.pwm_duty_cycle,
-                    task_settings.pwm_frequency_hz,
-                    task_settings.output_mask,
-                    task_settings.events,
-                    task_settings.mute,
-                    task_settings.delta1_us,
-                    task_settings.delta2_us,
-                    task_settings.delta3_us,
-                    task_settings.delta4_us);
-            }
-        }
+void start_sequence_at(uint32_t start_us)
+{
+    compile_fip_timeline(0);
+    frame_count = 0;
+    edge_telemetry.clear();
+    edge_telemetry_snapshot.publish(edge_telemetry);
+    rising_edge_event_ring.clear_stats();
+    trigger_latency_us.store(0, std::memory_order_relaxed);
+    max_trigger_latency_us.store(0, std::memory_order_relaxed);
+    // With no edges to replay, the CPU backend just idles.
+    bool has_edges = (fip_timeline.edge_count() > 0);
+    uint8_t backend = CPU_BACKEND;
+    if (has_edges && (schedule_backend == PIO_BACKEND) && load_pio_edge_engine())
+        backend = PIO_BACKEND;
+    else if (has_edges && (schedule_backend == TIMER_IRQ_BACKEND))
+        backend = TIMER_IRQ_BACKEND;
+    active_schedule_backend.store(backend, std::memory_order_relaxed);
+    if ((backend == TIMER_IRQ_BACKEND) && !edge_alarm_initialized)
+    {
+        // The interrupt is routed to the core that claims the alarm.
+        hal_alarm_init(on_edge_alarm);
+        edge_alarm_initialized = true;
+    }
+    if (has_edges && (trigger_config.mode != TRIGGER_NONE))
+    {
+        // on_trigger() starts the first frame.
+        awaiting_trigger = true;
+        return;
+    }
+    // Start the PIO on a timer tick so that its edges line up with the
+    // microsecond deadlines core1 reports events against. Leave the timer
+    // IRQ backend a tick more so that the first deadline can't pass before
+    // the alarm is armed. A start time that is closer than that (or has
+    // passed) starts as soon as possible instead.
+    uint32_t earliest_start_us = hal_time_us_32();
+    if (backend == PIO_BACKEND)
+        earliest_start_us += 1;
+    else if (backend == TIMER_IRQ_BACKEND)
+        earliest_start_us += 2;
+    frame_start_us = start_us;
+    if (int32_t(start_us - earliest_start_us) < 0)
+        frame_start_us = earliest_start_us;
+    if (backend == PIO_BACKEND)
+    {
+        frame_start_us = hal_busy_wait_until_us_32_or_doorbell(frame_start_us);
+        if (!hal_doorbell_rung())
+            pio_edge_engine.start();
+    }
+    edge_telemetry.session_start_us = frame_start_us;
+    if (backend == TIMER_IRQ_BACKEND)
+    {
+        next_edge_index = 0;
+        hal_alarm_arm(frame_start_us + fip_timeline[0].offset_us);
     }
 }
 
+void stop_sequence()
+{
+    start_pending = false;
+    awaiting_trigger = false;
+    cycle_change_pending = false;
+    if (pio_edge_engine.running())
+        pio_edge_engine.stop();
+    if (edge_alarm_initialized)
+        hal_alarm_disarm();
+    // The timer IRQ backend can stop mid-frame.
+    uint32_t output_mask = 0;
+    for (auto& edge: fip_timeline)
+        output_mask |= edge.set_mask;
+    hal_gpio_put_masked(output_mask, 0);
+    hal_pwm_put_masked(pwm_state, 0);
+    pwm_state = 0;
+}
+
 void run()
 {
     enabled = false;
     // do a continuous sequence.
     while (true)
+        run_once();
+}
+
+void run_once()
+{
+    // Stop now if core0 rang the doorbell.
+    update_abort_state();
+    // Apply core0's commands in the order it sent them.
+    update_commands();
+    if (!enabled || start_pending)
+        apply_task_table(0);
+    if (start_pending)
+        wait_for_scheduled_start();
+    else if (enabled)
+        run_sequence();
+    else
+        hal_wait_for_event(); // Idle until core0 changes something.
+}
+
+void wait_for_scheduled_start()
+{
+    // Wait in short slices so that a disable during the lead time stops the
+    // schedule before it starts.
+    uint32_t setup_us = scheduled_start_us - SCHEDULED_START_SETUP_US;
+    uint32_t now_us = hal_time_us_32();
+    if (int32_t(setup_us - now_us) > 0)
     {
-        // Check for input from core1.
-        update_enabled_state();
-        if (!enabled)
-            update_fip_tasks();
-        if (enabled)
-            run_sequence();
+        hal_busy_wait_until_us_32_or_doorbell(
+            now_us + std::min<uint32_t>(setup_us - now_us, SCHEDULED_START_POLL_US));
+        return;
     }
+    start_pending = false;
+    start_sequence_at(scheduled_start_us);
 }
 
-void push_harp_msg(uint32_t output_state, uint64_t time_us)
+void push_harp_msg(uint32_t output_state, uint32_t time_us)
 {
-    // Send rising edge output state to core0.
-    RisingEdgeEventData event_data = {output_state, time_us};
-    queue_try_add(&rising_edge_event_queue, &event_data);
+    // Send rising edge output state to core0. Drops are counted by the ring.
+    rising_edge_event_ring.try_push({output_state, time_us});
+}
+
+void apply_edge(const FIPEdge& edge)
+{
+    hal_gpio_put_masked(edge.set_mask | edge.clear_mask, edge.set_mask);
+    if (edge.pwm_enable_mask != pwm_state)
+    {
+        hal_pwm_put_masked(edge.pwm_enable_mask ^ pwm_state, edge.pwm_enable_mask);
+        pwm_state = edge.pwm_enable_mask;
+    }
+    if (edge.event)
+        push_harp_msg(edge.event_state, hal_time_us_32());
 }
 
 void run_sequence()
 {
-    for (auto& fip_task: fip_tasks)
-        run_exposure(fip_task);
-}
-
-inline void run_exposure(LaserFIPTask& fip_task)
-{
-    // TODO: consider tweaking delays to account for elapsed time to trigger signals.
-    //uint32_t start_time_us = time_us_32_fast();
-    //uint32_t elapsed_time_us;
-    fip_task.laser_.enable_output();
-    // Send pinmask state w/ pwm rising edge.
-    push_harp_msg((1u << fip_task.laser_.pin()), time_us_64_unsafe());
-    //elapsed_time_us = time_us_32_fast() - start_time_us;
-    //sleep_us(fip_task.settings_.delta3_us - elapsed_time_us);
-    sleep_us(fip_task.settings_.delta3_us);
-    fip_task.set_output();
-    // Send pinmask state w/ CAM_G rising edge.
-    push_harp_msg(
-        ((1u << fip_task.laser_.pin()) | fip_task.output_mask()),
-        time_us_64_unsafe());
-    sleep_us(fip_task.settings_.delta1_us);
-    fip_task.clear_output();
-    sleep_us(fip_task.settings_.delta4_us);
-    fip_task.laser_.disable_output();
-    sleep_us(fip_task.settings_.delta2_us);
+    if (awaiting_trigger)
+    {
+        // Sleep until on_trigger() starts the next frame (or core0 writes).
+        hal_wait_for_event();
+        return;
+    }
+    switch (active_schedule_backend.load(std::memory_order_relaxed))
+    {
+        case PIO_BACKEND:
+            run_pio_sequence();
+            break;
+        case TIMER_IRQ_BACKEND:
+            run_timer_irq_sequence();
+            break;
+        default:
+            run_cpu_sequence();
+            break;
+    }
+    // A finite acquisition stops on its own once its last frame is over.
+    if (acquisition_complete())
+        end_acquisition();
+}
+
+void run_cpu_sequence()
+{
+    for (auto& edge: fip_timeline)
+    {
+        uint32_t deadline_us = frame_start_us + edge.offset_us;
+        uint32_t now_us = hal_busy_wait_until_us_32_or_doorbell(deadline_us);
+        if (hal_doorbell_rung())
+            return; // run() stops the outputs.
+        apply_edge(edge);
+        edge_telemetry.record(now_us - deadline_us);
+        if (trigger_latency_pending)
+            record_trigger_latency(now_us);
+    }
+    edge_telemetry_snapshot.publish(edge_telemetry);
+    // Every frame starts exactly when the frames before it add up to.
+    frame_start_us += fip_timeline.period_us();
+    frame_count += fip_timeline.frame_count();
+    if (acquisition_complete())
+        return;
+    // Swap in a new task table in the idle gap before the next frame.
+    prepare_next_cycle();
+    if (trigger_config.mode == TRIGGER_EACH_FRAME)
+    {
+        awaiting_trigger = true;
+        return;
+    }
+    hal_busy_wait_until_us_32_or_doorbell(frame_start_us);
 }
 
+void run_pio_sequence()
+{
+    // The PIO can't replay frames without edges (see on_edge_alarm()).
+    if (fip_timeline.edge_count() == 0)
+    {
+        active_schedule_backend.store(CPU_BACKEND, std::memory_order_relaxed);
+        return;
+    }
+    if (!pio_edge_engine.running())
+    {
+        // A triggered frame.
+        hal_busy_wait_until_us_32_or_doorbell(frame_start_us);
+        if (hal_doorbell_rung())
+            return;
+        pio_edge_engine.start();
+        if (trigger_latency_pending)
+            record_trigger_latency(frame_start_us + fip_timeline[0].offset_us);
+    }
+    for (auto& edge: fip_timeline)
+    {
+        if (!edge.event)
+            continue;
+        uint32_t deadline_us = frame_start_us + edge.offset_us;
+        hal_busy_wait_until_us_32_or_doorbell(deadline_us);
+        if (hal_doorbell_rung())
+            return; // run() stops the PIO.
+        push_harp_msg(edge.event_state, deadline_us);
+    }
+    // Return once the last edge has passed so that a stop request lands in
+    // the idle gap at the end of the frame while all outputs are LOW.
+    uint32_t last_offset_us = fip_timeline[fip_timeline.edge_count() - 1].offset_us;
+    hal_busy_wait_until_us_32_or_doorbell(frame_start_us + last_offset_us + 1);
+    if (hal_doorbell_rung())
+        return;
+    // The PIO writes every edge on its deadline's clock cycle.
+    edge_telemetry.record_on_time(fip_timeline.edge_count());
+    edge_telemetry_snapshot.publish(edge_telemetry);
+    // Every frame starts exactly when the frames before it add up to.
+    frame_start_us += fip_timeline.period_us();
+    frame_count += fip_timeline.frame_count();
+    if (acquisition_complete())
+        return;
+    if (trigger_config.mode == TRIGGER_EACH_FRAME)
+    {
+        // Reload the PIO to wait for the next trigger.
+        pio_edge_engine.stop();
+        prepare_next_cycle();
+        if (!load_pio_edge_engine())
+            active_schedule_backend.store(CPU_BACKEND, std::memory_order_relaxed);
+        awaiting_trigger = true;
+        return;
+    }
+    if (!task_table_swap.is_pending() && !next_cycle_differs())
+        return;
+    // Reload the PIO with the new table (or the shortened last cycle) and
+    // restart it on the next frame boundary.
+    pio_edge_engine.stop();
+    prepare_next_cycle();
+    if (!load_pio_edge_engine())
+    {
+        // Carry on without the PIO.
+        active_schedule_backend.store(CPU_BACKEND, std::memory_order_relaxed);
+        return;
+    }
+    hal_busy_wait_until_us_32_or_doorbell(frame_start_us);
+    if (!hal_doorbell_rung())
+        pio_edge_engine.start();
+}
+
+void run_timer_irq_sequence()
+{
+    if (!cycle_change_pending)
+    {
+        hal_wait_for_event();
+        return;
+    }
+    // The alarm stays disarmed until the next cycle is ready.
+    cycle_change_pending = false;
+    prepare_next_cycle();
+    if (trigger_config.mode == TRIGGER_EACH_FRAME)
+    {
+        awaiting_trigger = true;
+        return;
+    }
+    // The last frames of a finite acquisition may skip every task, leaving no
+    // edge to arm the alarm for. The CPU backend waits them out.
+    if (fip_timeline.edge_count() == 0)
+    {
+        active_schedule_backend.store(CPU_BACKEND, std::memory_order_relaxed);
+        return;
+    }
+    next_edge_index = 0;
+    // Write the first edge right away if preparing the cycle outlasted the
+    // idle gap before it.
+    if (!hal_alarm_arm(frame_start_us + fip_timeline[0].offset_us))
+        on_edge_alarm();
+}
+
+void on_edge_alarm()
+{
+    hal_alarm_clear();
+    // Write every edge that is due. Edges closer together than the handler
+    // takes to run are written back-to-back.
+    uint32_t deadline_us;
+    do
+    {
+        const FIPEdge& edge = fip_timeline[next_edge_index];
+        uint32_t now_us = hal_time_us_32();
+        apply_edge(edge);
+        edge_telemetry.record(now_us - (frame_start_us + edge.offset_us));
+        if (trigger_latency_pending)
+            record_trigger_latency(now_us);
+        if (++next_edge_index == fip_timeline.edge_count())
+        {
+            edge_telemetry_snapshot.publish(edge_telemetry);
+            // Every frame starts exactly when the frames before it add up to.
+            frame_start_us += fip_timeline.period_us();
+            frame_count += fip_timeline.frame_count();
+            next_edge_index = 0;
+            // run() ends the acquisition once the handler returns.
+            if (acquisition_complete())
+                return;
+            // A new task table (or the shortened last cycle) reconfigures the
+            // hardware and recompiles the timeline, which grows with the task
+            // count. run_timer_irq_sequence() does it in the idle gap before
+            // the next frame so that this handler stays short.
+            if (task_table_swap.is_pending() || next_cycle_differs())
+            {
+                cycle_change_pending = true;
+                return;
+            }
+            if (trigger_config.mode == TRIGGER_EACH_FRAME)
+            {
+                awaiting_trigger = true;
+                return;
+            }
+        }
+        deadline_us = frame_start_us + fip_timeline[next_edge_index].offset_us;
+    } while (!hal_alarm_arm(deadline_us));
+}
+
+void on_trigger()
+{
+    uint32_t now_us = hal_time_us_32();
+    if (!awaiting_trigger)
+        return; // Mid-frame or not armed.
+    awaiting_trigger = false;
+    trigger_time_us = now_us;
+    trigger_latency_pending = (fip_timeline.edge_count() > 0);
+    // Start a fixed time after the edge so that the latency to the frame's
+    // first edge doesn't depend on what core1 was doing.
+    frame_start_us = now_us + TRIGGER_START_DELAY_US;
+    if (frame_count == 0)
+        edge_telemetry.session_start_us = frame_start_us;
+    if (active_schedule_backend.load(std::memory_order_relaxed) != TIMER_IRQ_BACKEND)
+        return;
+    if (fip_timeline.edge_count() == 0)
+    {
+        // Nothing to arm the alarm for (see on_edge_alarm()).
+        active_schedule_backend.store(CPU_BACKEND, std::memory_order_relaxed);
+        return;
+    }
+    next_edge_index = 0;
+    hal_alarm_arm(frame_start_us + fip_timeline[0].offset_us);
+}
+
+void record_trigger_latency(uint32_t first_edge_us)
+{
+    trigger_latency_pending = false;
+    uint32_t latency_us = first_edge_us - trigger_time_us;
+    trigger_latency_us.store(latency_us, std::memory_order_relaxed);
+    if (latency_us > max_trigger_latency_us.load(std::memory_order_relaxed))
+        max_trigger_latency_us.store(latency_us, std::memory_order_relaxed);
+}
@@ -0,0 +1,115 @@
+#include <fip_timeline.h>
+
+void FIPTimeline::clear()
+{
+    edge_count_ = 0;
+    period_us_ = 0;
+    frame_start_us_ = 0;
+    frame_count_ = 0;
+    pwm_state_ = 0;
+    frame_first_edge_ = 0;
+    frame_exposure_count_ = 0;
+}
+
+bool FIPTimeline::append_task(const LaserFIPTaskSettings& settings)
+{
+    if (edge_count_ + EDGES_PER_TASK > MAX_EDGE_COUNT)
+        return false;
+    uint32_t laser_mask = settings.pwm_pin_bit;
+    // A muted task keeps its timing and laser, but never raises its outputs.
+    uint32_t output_mask = settings.mute? 0: settings.output_mask;
+    uint32_t offset_us = period_us_;
+    if (pipelined_)
+    {
+        if (frame_exposure_count_ == MAX_TASK_COUNT)
+            return false;
+        offset_us = uint32_t(pipelined_start_us(settings, frame_start_us_,
+                                                frame_exposures_,
+                                                frame_exposure_count_));
+        frame_exposures_[frame_exposure_count_++]
+            = TaskExposure::place(settings, offset_us);
+    }
+    // Resolve event subscriptions here so that core1 never checks them.
+    uint8_t edge_events = settings.edge_events();
+    uint32_t end_us = offset_us + settings.delta3_us + settings.delta1_us
+                      + settings.delta4_us + settings.delta2_us;
+    if (end_us > period_us_)
+        period_us_ = end_us;
+
+    if ((edge_count_ > frame_first_edge_)
+        && (offset_us < edges_[edge_count_ - 1].offset_us))
+    {
+        // The task overlaps the frame's earlier tasks. Its edges are merged
+        // in by time, so the PWM and output states after each edge are
+        // rebuilt from the changes each edge makes. Tasks in the same frame
+        // never share a laser while pipelined, so a laser's changes are
+        // toggles. Every frame starts with all outputs LOW.
+        for (size_t index = edge_count_ - 1; index > frame_first_edge_; --index)
+            edges_[index].pwm_enable_mask ^= edges_[index - 1].pwm_enable_mask;
+        const FIPEdge task_edges[EDGES_PER_TASK] =
+        {
+            {offset_us, 0, 0, laser_mask, 0, bool(edge_events & EVENT_LASER_ON)},
+            {offset_us + settings.delta3_us, output_mask, 0, 0, 0,
+             bool(edge_events & EVENT_CAMERA_ON)},
+            {offset_us + settings.delta3_us + settings.delta1_us, 0,
+             settings.output_mask, 0, 0, bool(edge_events & EVENT_CAMERA_OFF)},
+            {end_us - settings.delta2_us, 0, 0, laser_mask, 0,
+             bool(edge_events & EVENT_LASER_OFF)},
+        };
+        for (const FIPEdge& task_edge: task_edges)
+        {
+            // After the edges at the same time, like the sequential order.
+            size_t index = edge_count_++;
+            for (; (index > frame_first_edge_)
+                   && (edges_[index - 1].offset_us > task_edge.offset_us); --index)
+                edges_[index] = edges_[index - 1];
+            edges_[index] = task_edge;
+        }
+        uint32_t gpio_state = 0;
+        pwm_state_ = 0;
+        for (size_t index = frame_first_edge_; index < edge_count_; ++index)
+        {
+            FIPEdge& edge = edges_[index];
+            pwm_state_ ^= edge.pwm_enable_mask;
+            gpio_state = (gpio_state & ~edge.clear_mask) | edge.set_mask;
+            edge.pwm_enable_mask = pwm_state_;
+            edge.event_state = pwm_state_ | gpio_state;
+        }
+        return true;
+    }
+
+    // Laser on.
+    pwm_state_ |= laser_mask;
+    edges_[edge_count_++] = {offset_us, 0, 0, pwm_state_, pwm_state_,
+                             bool(edge_events & EVENT_LASER_ON)};
+    // Camera trigger on.
+    offset_us += settings.delta3_us;
+    edges_[edge_count_++] = {offset_us, output_mask, 0, pwm_state_,
+                             pwm_state_ | output_mask,
+                             bool(edge_events & EVENT_CAMERA_ON)};
+    // Camera trigger off.
+    offset_us += settings.delta1_us;
+    edges_[edge_count_++] = {offset_us, 0, settings.output_mask, pwm_state_,
+                             pwm_state_, bool(edge_events & EVENT_CAMERA_OFF)};
+    // Laser off.
+    offset_us += settings.delta4_us;
+    pwm_state_ &= ~laser_mask;
+    edges_[edge_count_++] = {offset_us, 0, 0, pwm_state_, pwm_state_,
+                             bool(edge_events & EVENT_LASER_OFF)};
+    return true;
+}
+
+bool FIPTimeline::end_frame(uint32_t fixed_frame_period_us)
+{
+    frame_first_edge_ = edge_count_;
+    frame_exposure_count_ = 0;
+    if (fixed_frame_period_us)
+    {
+        if (period_us_ - frame_start_us_ > fixed_frame_period_us)
+            return false;
+        period_us_ = frame_start_us_ + fixed_frame_period_us;
+    }
+    frame_start_us_ = period_us_;
+    ++frame_count_;
+    return true;
+}
@@ -1,26 +1,110 @@
 #include <laser_fip_task.h>
 
 
-LaserFIPTask::LaserFIPTask(
-    size_t pwm_pin, float pwm_duty_cycle, float pwm_frequency_hz,
-    uint32_t output_mask, bool enable_events, bool mute_output,
-    uint32_t delta1_us, uint32_t delta2_us, uint32_t delta3_us,
-    uint32_t delta4_us)
-:settings_{pwm_pin, pwm_duty_cycle, pwm_frequency_hz, output_mask, enable_events,
-    mute_output, delta1_us, delta2_us, delta3_us, delta4_us},
- laser_(pwm_pin)
+LaserPWMConfig LaserPWMConfig::resolve(float duty_cycle, float frequency_hz,
+                                       uint32_t sys_clk_hz)
+{
+    constexpr uint32_t MIN_CLKDIV_X16 = 16;
+    constexpr uint32_t MAX_CLKDIV_X16 = 0xFFF;
+    constexpr uint32_t MAX_PERIOD = 1u << 16; // wrap + 1
+    // Constant levels. The counter wraps every cycle.
+    if ((duty_cycle <= 0) || (duty_cycle >= 1) || (frequency_hz <= 0))
+        return {MIN_CLKDIV_X16, 0, uint16_t((duty_cycle > 0)? 1: 0)};
+    // Period in sixteenths of a system clock cycle.
+    float period_x16 = float(sys_clk_hz) * 16.f / frequency_hz;
+    if (period_x16 > float(MAX_CLKDIV_X16 * MAX_PERIOD))
+        period_x16 = float(MAX_CLKDIV_X16 * MAX_PERIOD);
+    uint32_t period = uint32_t(period_x16 + 0.5f);
+    uint32_t clkdiv_x16 = (period + MAX_PERIOD - 1) / MAX_PERIOD;
+    if (clkdiv_x16 < MIN_CLKDIV_X16)
+        clkdiv_x16 = MIN_CLKDIV_X16;
+    uint32_t wrap_plus_1 = (period + clkdiv_x16 / 2) / clkdiv_x16;
+    if (wrap_plus_1 < 2)
+        wrap_plus_1 = 2;
+    else if (wrap_plus_1 > MAX_PERIOD)
+        wrap_plus_1 = MAX_PERIOD;
+    uint32_t level = uint32_t(duty_cycle * float(wrap_plus_1) + 0.5f);
+    return {uint16_t(clkdiv_x16), uint16_t(wrap_plus_1 - 1),
+            uint16_t((level < wrap_plus_1)? level: wrap_plus_1 - 1)};
+}
+
+
+TaskExposure TaskExposure::place(const LaserFIPTaskSettings& settings,
+                                 uint64_t start_us)
+{
+    uint64_t camera_on_us = start_us + settings.delta3_us;
+    uint64_t camera_off_us = camera_on_us + settings.delta1_us;
+    uint64_t laser_off_us = camera_off_us + settings.delta4_us;
+    return {settings.pwm_pin_bit, settings.output_mask, start_us, camera_on_us,
+            camera_off_us, laser_off_us, laser_off_us + settings.delta2_us};
+}
+
+
+uint64_t pipelined_start_us(const LaserFIPTaskSettings& settings,
+                            uint64_t frame_start_us, const TaskExposure* placed,
+                            size_t placed_count)
+{
+    uint64_t start_us = frame_start_us;
+    if (placed_count && (placed[placed_count - 1].start_us > start_us))
+        start_us = placed[placed_count - 1].start_us;
+    for (size_t index = 0; index < placed_count; ++index)
+    {
+        const TaskExposure& exposure = placed[index];
+        uint64_t earliest_us;
+        if ((exposure.laser_mask & settings.pwm_pin_bit)
+            || (exposure.camera_mask & settings.output_mask))
+            earliest_us = exposure.end_us;
+        else
+        {
+            // Laser on after the earlier camera turns off, and camera on after
+            // the earlier laser turns off.
+            earliest_us = exposure.camera_off_us;
+            if (exposure.laser_off_us > earliest_us + settings.delta3_us)
+                earliest_us = exposure.laser_off_us - settings.delta3_us;
+        }
+        if (earliest_us > start_us)
+            start_us = earliest_us;
+    }
+    return start_us;
+}
+
+
+LaserFIPTask::LaserFIPTask(const LaserFIPTaskSettings& settings,
+                           const LaserPWMConfig& pwm)
+:settings_{settings},
+ pwm_{pwm},
+ pwm_pin_(LaserFIPTaskSettings::onehot_to_pin(settings.pwm_pin_bit))
 {
     // Configure outputs.
-    gpio_init_mask(output_mask);
-    gpio_set_dir_masked(output_mask, 0xFFFFFFFF);
+    hal_gpio_init_outputs(settings.output_mask);
 
-    // Configure initial laser settings.
-    laser_.set_duty_cycle(pwm_duty_cycle);
-    laser_.set_frequency(pwm_frequency_hz);
+    // Leave the PWM slice running and gate the laser by switching its pin
+    // between the PWM and a LOW gpio output.
+    hal_gpio_init_outputs(settings.pwm_pin_bit);
+    hal_pwm_configure(pwm_pin_, pwm.clkdiv_x16, pwm.wrap, pwm.level);
 };
 
 
 
+void LaserFIPTask::apply_settings(const LaserFIPTaskSettings& settings,
+                                  const LaserPWMConfig& pwm)
+{
+    if (settings.output_mask != settings_.output_mask)
+        hal_gpio_init_outputs(settings.output_mask);
+    if (settings.pwm_pin_bit != settings_.pwm_pin_bit)
+    {
+        pwm_pin_ = LaserFIPTaskSettings::onehot_to_pin(settings.pwm_pin_bit);
+        hal_gpio_init_outputs(settings.pwm_pin_bit);
+        hal_pwm_configure(pwm_pin_, pwm.clkdiv_x16, pwm.wrap, pwm.level);
+    }
+    else if (!(pwm == pwm_))
+        hal_pwm_configure(pwm_pin_, pwm.clkdiv_x16, pwm.wrap, pwm.level);
+    settings_ = settings;
+    pwm_ = pwm;
+}
+
+
+
 LaserFIPTask::~LaserFIPTask()
 {
 
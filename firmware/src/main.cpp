@@ -9,12 +9,10 @@
 #include <hardware/structs/bus_ctrl.h>
 #include <core1_main.h>
 
-queue_t enable_task_schedule_queue;
-queue_t add_task_queue;
-queue_t remove_task_queue;
-queue_t clear_tasks_queue;
-queue_t reconfigure_task_queue;
-queue_t rising_edge_event_queue;
+queue_t core1_command_queue;
+RisingEdgeEventRing rising_edge_event_ring;
+AcquisitionEndRing acquisition_end_ring;
+TaskTableSwap task_table_swap;
 
 HarpCApp& app = HarpCApp::init(FIP_WHO_AM_I, 0, 0,
                                0,
@@ -22,8 +20,8 @@ HarpCApp& app = HarpCApp::init(FIP_WHO_AM_I, 0, 0,
                                0, 0,
                                0, "cuttlefish-fip",
                                (uint8_t*)GIT_HASH,
-                               &app_regs, app_reg_specs,
-                               reg_handler_fns, REG_COUNT, update_app,
+                               &app_regs, app_reg_specs().data(),
+                               reg_handler_fns.data(), REG_COUNT, update_app,
                                reset_app);
 /*
 
@@ -47,12 +45,7 @@ int main()
     // Configure core1 to have high bus priority.
     bus_ctrl_hw->priority = 0x00000010;
     // Initialize queues for multicore communication.
-    queue_init(&enable_task_schedule_queue, sizeof(uint8_t), MAX_QUEUE_SIZE);
-    queue_init(&add_task_queue, sizeof(LaserFIPTaskSettings), MAX_QUEUE_SIZE);
-    queue_init(&remove_task_queue, sizeof(uint8_t), MAX_QUEUE_SIZE);
-    queue_init(&clear_tasks_queue, sizeof(uint8_t), MAX_QUEUE_SIZE);
-    queue_init(&reconfigure_task_queue, sizeof(ReconfigureTaskData), MAX_QUEUE_SIZE);
-    queue_init(&rising_edge_event_queue, sizeof(RisingEdgeEventData), MAX_QUEUE_SIZE);
+    queue_init(&core1_command_queue, sizeof(Core1Command), CORE1_COMMAND_QUEUE_SIZE);
 
 #if defined(DEBUG)
 #warning "Initializing printf from UART will slow down core1 main loop."
@@ -0,0 +1,88 @@
+#include <pio_edge_engine.h>
+#include <fip_hal.h>
+#include <hardware/pio.h>
+#include <hardware/dma.h>
+#include <fip_edge_engine.pio.h>
+
+#define FIP_EDGE_PIO (pio0)
+
+void PIOEdgeEngine::init()
+{
+    if (initialized_)
+        return;
+    program_offset_ = pio_add_program(FIP_EDGE_PIO, &fip_edge_engine_program);
+    sm_ = pio_claim_unused_sm(FIP_EDGE_PIO, true);
+    data_channel_ = dma_claim_unused_channel(true);
+    ctrl_channel_ = dma_claim_unused_channel(true);
+    initialized_ = true;
+}
+
+void PIOEdgeEngine::load(const PIOEdgeTable& table)
+{
+    init();
+    table_ = &table;
+    table_words_ = table.words();
+    pin_mask_ = table.pin_mask();
+
+    pio_sm_config config = fip_edge_engine_program_get_default_config(program_offset_);
+    sm_config_set_out_pins(&config, PORT_BASE, PIO_EDGE_PIN_COUNT);
+    // Shift right so the pin levels come out first. Autopull every word.
+    sm_config_set_out_shift(&config, true, true, 32);
+    sm_config_set_fifo_join(&config, PIO_FIFO_JOIN_TX);
+    sm_config_set_clkdiv_int_frac(&config, 1, 0); // One cycle per system clock.
+    pio_sm_init(FIP_EDGE_PIO, sm_, program_offset_, &config);
+
+    // Hand the schedule's pins to the PIO, starting LOW.
+    pio_sm_set_pins_with_mask(FIP_EDGE_PIO, sm_, 0, pin_mask_);
+    pio_sm_set_pindirs_with_mask(FIP_EDGE_PIO, sm_, pin_mask_, pin_mask_);
+    for (uint32_t mask = pin_mask_; mask; mask &= mask - 1)
+        pio_gpio_init(FIP_EDGE_PIO, __builtin_ctz(mask));
+
+    // Data channel: stream one frame into the TX FIFO, then chain to ctrl.
+    dma_channel_config data_config = dma_channel_get_default_config(data_channel_);
+    channel_config_set_transfer_data_size(&data_config, DMA_SIZE_32);
+    channel_config_set_read_increment(&data_config, true);
+    channel_config_set_write_increment(&data_config, false);
+    channel_config_set_dreq(&data_config, pio_get_dreq(FIP_EDGE_PIO, sm_, true));
+    channel_config_set_chain_to(&data_config, ctrl_channel_);
+    dma_channel_configure(data_channel_, &data_config, &FIP_EDGE_PIO->txf[sm_],
+                          table_words_, table.word_count(), false);
+
+    // Control channel: rewind the data channel to the start of the frame and
+    // retrigger it. The transfer count reloads on trigger.
+    dma_channel_config ctrl_config = dma_channel_get_default_config(ctrl_channel_);
+    channel_config_set_transfer_data_size(&ctrl_config, DMA_SIZE_32);
+    channel_config_set_read_increment(&ctrl_config, false);
+    channel_config_set_write_increment(&ctrl_config, false);
+    dma_channel_configure(ctrl_channel_, &ctrl_config,
+                          &dma_hw->ch[data_channel_].al3_read_addr_trig,
+                          &table_words_, 1, false);
+
+    // Prefill the FIFO. The state machine is not running yet.
+    dma_channel_start(data_channel_);
+}
+
+void PIOEdgeEngine::start()
+{
+    pio_sm_set_enabled(FIP_EDGE_PIO, sm_, true);
+    running_ = true;
+}
+
+void PIOEdgeEngine::stop()
+{
+    if (!table_)
+        return;
+    pio_sm_set_enabled(FIP_EDGE_PIO, sm_, false);
+    // Break the chain before aborting so ctrl can't retrigger the data channel.
+    dma_channel_config data_config = dma_get_channel_config(data_channel_);
+    channel_config_set_chain_to(&data_config, data_channel_);
+    dma_channel_set_config(data_channel_, &data_config, false);
+    dma_channel_abort(ctrl_channel_);
+    dma_channel_abort(data_channel_);
+    pio_sm_clear_fifos(FIP_EDGE_PIO, sm_);
+    pio_sm_restart(FIP_EDGE_PIO, sm_);
+    // Return the pins to LOW gpio outputs.
+    hal_gpio_init_outputs(pin_mask_);
+    table_ = nullptr;
+    running_ = false;
+}
@@ -0,0 +1,156 @@
+#include <pio_edge_table.h>
+
+LaserPWMTiming LaserPWMTiming::from_config(uint32_t pin_mask,
+                                           const LaserPWMConfig& pwm)
+{
+    // Match the PWM slice the CPU backends use, to the nearest cycle.
+    LaserPWMTiming timing{pin_mask, pwm.period_cycles(), pwm.high_cycles()};
+    // Constant levels.
+    if ((timing.high_cycles == 0) || (timing.high_cycles == timing.period_cycles))
+        return timing;
+    // The PIO can't hold a level for less than PIO_EDGE_MIN_HOLD_CYCLES.
+    if (timing.high_cycles < PIO_EDGE_MIN_HOLD_CYCLES)
+        timing.high_cycles = 0;
+    else if (timing.period_cycles - timing.high_cycles < PIO_EDGE_MIN_HOLD_CYCLES)
+        timing.high_cycles = timing.period_cycles;
+    return timing;
+}
+
+bool PIOEdgeTable::emit(uint32_t hold_cycles, uint32_t output_state)
+{
+    if (word_count_ == PIO_EDGE_TABLE_CAPACITY)
+        return false;
+    words_[word_count_++] = encode_word(hold_cycles, output_state);
+    return true;
+}
+
+bool PIOEdgeTable::close_pending(uint32_t cycle, uint32_t& next_start_cycle)
+{
+    uint32_t hold_cycles = cycle - pending_start_cycle_;
+    next_start_cycle = cycle;
+    if (hold_cycles == 0) // Superseded on the same cycle.
+        return true;
+    if (hold_cycles < PIO_EDGE_MIN_HOLD_CYCLES)
+    {
+        // Too short for the PIO. Drop the state by extending the previous one
+        // or, at the start of the frame, by starting the next one early.
+        if (word_count_ == 0)
+            next_start_cycle = pending_start_cycle_;
+        else
+            words_[word_count_ - 1] += hold_cycles << PIO_EDGE_PIN_COUNT;
+        return true;
+    }
+    while (hold_cycles > PIO_EDGE_MAX_HOLD_CYCLES)
+    {
+        // Split long holds without leaving a sub-minimum remainder.
+        uint32_t chunk_cycles = PIO_EDGE_MAX_HOLD_CYCLES;
+        if (hold_cycles - PIO_EDGE_MAX_HOLD_CYCLES < PIO_EDGE_MIN_HOLD_CYCLES)
+            chunk_cycles -= PIO_EDGE_MIN_HOLD_CYCLES;
+        if (!emit(chunk_cycles, pending_state_))
+            return false;
+        hold_cycles -= chunk_cycles;
+    }
+    return emit(hold_cycles, pending_state_);
+}
+
+bool PIOEdgeTable::breakpoint(uint32_t cycle, uint32_t output_state)
+{
+    if (output_state == pending_state_)
+        return true;
+    uint32_t start_cycle;
+    if (!close_pending(cycle, start_cycle))
+        return false;
+    pending_state_ = output_state;
+    pending_start_cycle_ = start_cycle;
+    return true;
+}
+
+bool PIOEdgeTable::encode(const FIPTimeline& timeline,
+                          const LaserPWMTiming* pwm_timings,
+                          size_t pwm_timing_count, uint32_t cycles_per_us)
+{
+    word_count_ = 0;
+    pin_mask_ = 0;
+    frame_cycles_ = 0;
+    uint64_t frame_cycles = uint64_t(timeline.period_us()) * cycles_per_us;
+    if ((timeline.edge_count() == 0) || (frame_cycles < PIO_EDGE_MIN_HOLD_CYCLES)
+        || (frame_cycles > UINT32_MAX))
+        return false;
+    frame_cycles_ = uint32_t(frame_cycles);
+    for (auto& edge: timeline)
+        pin_mask_ |= edge.set_mask | edge.clear_mask | edge.pwm_enable_mask;
+    if (pin_mask_ & ~PIO_EDGE_PIN_MASK)
+        return false;
+
+    // PWM waveform of each IO pin's laser and the cycle it last turned on.
+    LaserPWMTiming pin_pwm[PIO_EDGE_PIN_COUNT]{};
+    uint32_t laser_on_cycle[PIO_EDGE_PIN_COUNT]{};
+    for (size_t index = 0; index < pwm_timing_count; ++index)
+    {
+        uint32_t mask = pwm_timings[index].pin_mask & PIO_EDGE_PIN_MASK;
+        for (; mask; mask &= mask - 1)
+            pin_pwm[__builtin_ctz(mask) - PORT_BASE] = pwm_timings[index];
+    }
+
+    uint32_t gpio_state = 0;
+    uint32_t laser_state = 0; // lasers enabled, whether or not their PWM is HIGH.
+    auto output_state = [&](uint32_t cycle)
+    {
+        uint32_t state = gpio_state;
+        for (uint32_t mask = laser_state; mask; mask &= mask - 1)
+        {
+            uint32_t pin_index = __builtin_ctz(mask) - PORT_BASE;
+            const LaserPWMTiming& pwm = pin_pwm[pin_index];
+            if ((pwm.high_cycles >= pwm.period_cycles)
+                || (((cycle - laser_on_cycle[pin_index]) % pwm.period_cycles)
+                    < pwm.high_cycles))
+                state |= (1u << (pin_index + PORT_BASE));
+        }
+        return state;
+    };
+
+    pending_state_ = 0;
+    pending_start_cycle_ = 0;
+    uint32_t cycle = 0;
+    for (size_t index = 0; index <= timeline.edge_count(); ++index)
+    {
+        uint32_t edge_cycle = (index < timeline.edge_count())?
+            timeline[index].offset_us * cycles_per_us: frame_cycles_;
+        // Synthesize every PWM toggle before the next edge.
+        while (true)
+        {
+            uint32_t next_cycle = edge_cycle;
+            for (uint32_t mask = laser_state; mask; mask &= mask - 1)
+            {
+                uint32_t pin_index = __builtin_ctz(mask) - PORT_BASE;
+                const LaserPWMTiming& pwm = pin_pwm[pin_index];
+                if ((pwm.high_cycles == 0) || (pwm.high_cycles >= pwm.period_cycles))
+                    continue;
+                uint32_t elapsed_cycles = cycle - laser_on_cycle[pin_index];
+                uint32_t period_start = cycle - (elapsed_cycles % pwm.period_cycles);
+                uint32_t toggle_cycle = period_start + pwm.high_cycles;
+                if (toggle_cycle <= cycle)
+                    toggle_cycle = period_start + pwm.period_cycles;
+                if (toggle_cycle < next_cycle)
+                    next_cycle = toggle_cycle;
+            }
+            if (next_cycle >= edge_cycle)
+                break;
+            cycle = next_cycle;
+            if (!breakpoint(cycle, output_state(cycle)))
+                return false;
+        }
+        if (index == timeline.edge_count())
+            break;
+        cycle = edge_cycle;
+        const FIPEdge& edge = timeline[index];
+        gpio_state = (gpio_state & ~edge.clear_mask) | edge.set_mask;
+        for (uint32_t mask = edge.pwm_enable_mask & ~laser_state; mask; mask &= mask - 1)
+            laser_on_cycle[__builtin_ctz(mask) - PORT_BASE] = cycle;
+        laser_state = edge.pwm_enable_mask;
+        if (!breakpoint(cycle, output_state(cycle)))
+            return false;
+    }
+    uint32_t unused_start_cycle;
+    return close_pending(frame_cycles_, unused_start_cycle);
+}
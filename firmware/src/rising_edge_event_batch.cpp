@@ -0,0 +1,23 @@
+#include <rising_edge_event_batch.h>
+
+void EventBatch::clear()
+{
+    for (auto& word: words_)
+        word = 0;
+    first_time_us_ = 0;
+}
+
+bool EventBatch::add(uint8_t port_state, uint64_t time_us)
+{
+    size_t index = count();
+    if (index == RISING_EDGE_EVENT_BATCH_CAPACITY)
+        return false;
+    if (index == 0)
+        first_time_us_ = time_us;
+    uint64_t offset_us = time_us - first_time_us_;
+    if (offset_us > RISING_EDGE_EVENT_BATCH_MAX_OFFSET_US)
+        return false;
+    words_[index + 1] = (uint32_t(port_state) << 24) | uint32_t(offset_us);
+    ++words_[0];
+    return true;
+}
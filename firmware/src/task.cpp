@@ -29,7 +29,7 @@ void Task::start()
 #endif
     event_index_ = 0;
     loops_ = 0;
-    start_time_us_ = timer_hw->timerawl;
+    start_time_us_ = hal_time_us_32();
     next_update_time_us_ = start_time_us_;
     // TODO: should we instead compute the next time to update as relative
     // to an absolute start time?
@@ -0,0 +1,261 @@
+#include <task_table.h>
+#include <algorithm>
+#include <bit>
+#include <numeric>
+
+bool TaskTableSwap::try_publish(const TaskTable& table)
+{
+    if (pending_.load(std::memory_order_acquire))
+        return false;
+    table_ = table;
+    pending_.store(true, std::memory_order_release);
+    return true;
+}
+
+const TaskTable* TaskTableSwap::pending() const
+{
+    if (!pending_.load(std::memory_order_acquire))
+        return nullptr;
+    return &table_;
+}
+
+void TaskTableSwap::release(uint32_t frame_index)
+{
+    applied_frame_.store(frame_index, std::memory_order_relaxed);
+    pending_.store(false, std::memory_order_release);
+}
+
+size_t add_task_slot(TaskTable& table)
+{
+    if (table.task_count == MAX_TASK_COUNT)
+        return NO_TASK_SLOT;
+    size_t slot = 0;
+    while (table.slot_used[slot])
+        ++slot;
+    table.slot_used[slot] = true;
+    table.order[table.task_count++] = uint8_t(slot);
+    return slot;
+}
+
+void remove_task_slot(TaskTable& table, size_t slot)
+{
+    if (!table.slot_used[slot])
+        return;
+    table.slot_used[slot] = false;
+    // Only the order entries after the task move.
+    uint8_t* end = table.order + table.task_count;
+    uint8_t* position = std::find(table.order, end, uint8_t(slot));
+    std::copy(position + 1, end, position);
+    --table.task_count;
+}
+
+void clear_task_slots(TaskTable& table)
+{
+    for (size_t i = 0; i < table.task_count; ++i)
+        table.slot_used[table.order[i]] = false;
+    table.task_count = 0;
+}
+
+bool CameraExposureWalk::append(uint64_t on_us, uint64_t off_us)
+{
+    if (off_us <= on_us)
+        return false;
+    if (!exposure_count)
+        first_on_us = on_us;
+    else if (on_us <= last_off_us)
+        return false;
+    ++exposure_count;
+    last_off_us = off_us;
+    return true;
+}
+
+bool CameraExposureWalk::wraps(uint64_t cycle_period_us) const
+{return !exposure_count || (last_off_us < first_on_us + cycle_period_us);}
+
+namespace
+{
+// Exposures of the tasks that run in one frame, and the slot of each.
+// Static: too large for the core0 stack at the higher task capacities.
+TaskExposure frame_exposures[MAX_TASK_COUNT];
+uint8_t frame_task_slots[MAX_TASK_COUNT];
+
+/**
+ * \brief place the tasks that run in a frame into frame_exposures, in run
+ *  order and relative to the frame start, the way core1 compiles them.
+ * \return how many tasks run in the frame.
+ */
+size_t place_frame_tasks(const TaskTable& table, uint32_t frame_index)
+{
+    size_t exposure_count = 0;
+    uint64_t end_us = 0;
+    for (size_t i = 0; i < table.task_count; ++i)
+    {
+        size_t slot = table.order[i];
+        if (!table.frame_divisors[slot].runs_in_frame(frame_index))
+            continue;
+        const LaserFIPTaskSettings& settings = table.tasks[slot];
+        uint64_t start_us = table.pipelined_exposures?
+            pipelined_start_us(settings, 0, frame_exposures, exposure_count): end_us;
+        frame_exposures[exposure_count] = TaskExposure::place(settings, start_us);
+        end_us = std::max(end_us, frame_exposures[exposure_count].end_us);
+        frame_task_slots[exposure_count++] = uint8_t(slot);
+    }
+    return exposure_count;
+}
+
+/**
+ * \brief duration of a frame, padded to the fixed frame period.
+ */
+uint64_t frame_period_us(const TaskTable& table, uint32_t frame_index)
+{
+    if (table.fixed_frame_period_us)
+        return table.fixed_frame_period_us;
+    return frame_task_time_us(table, frame_index);
+}
+}
+
+uint32_t frame_cycle_length(const TaskTable& table)
+{
+    uint32_t cycle_length = 1;
+    for (size_t i = 0; i < table.task_count; ++i)
+    {
+        const TaskFrameDivisor& frame_divisor = table.frame_divisors[table.order[i]];
+        if (frame_divisor.divisor <= 1)
+            continue;
+        if (frame_divisor.phase >= frame_divisor.divisor)
+            return 0;
+        cycle_length = std::lcm(cycle_length, uint32_t(frame_divisor.divisor));
+        if (cycle_length > MAX_CYCLE_FRAME_COUNT)
+            return 0;
+    }
+    return cycle_length;
+}
+
+uint64_t frame_task_time_us(const TaskTable& table, uint32_t frame_index)
+{
+    uint64_t time_us = 0;
+    size_t exposure_count = place_frame_tasks(table, frame_index);
+    for (size_t i = 0; i < exposure_count; ++i)
+        time_us = std::max(time_us, frame_exposures[i].end_us);
+    return time_us;
+}
+
+bool has_empty_frame(const TaskTable& table)
+{
+    uint32_t cycle_length = frame_cycle_length(table);
+    for (uint32_t frame = 0; frame < cycle_length; ++frame)
+    {
+        if (place_frame_tasks(table, frame) == 0)
+            return true;
+    }
+    return false;
+}
+
+uint32_t task_output_pins(const TaskTable& table)
+{
+    uint32_t pins = 0;
+    for (size_t i = 0; i < table.task_count; ++i)
+    {
+        const LaserFIPTaskSettings& settings = table.tasks[table.order[i]];
+        pins |= settings.pwm_pin_bit | settings.output_mask;
+    }
+    return pins;
+}
+
+ScheduleError check_schedule(const TaskTable& table)
+{
+    if (table.task_count == 0)
+        return SCHEDULE_OK;
+    uint32_t laser_pins = 0;
+    uint32_t camera_pins = 0;
+    for (size_t i = 0; i < table.task_count; ++i)
+    {
+        laser_pins |= table.tasks[table.order[i]].pwm_pin_bit;
+        camera_pins |= table.tasks[table.order[i]].output_mask;
+    }
+    if (laser_pins & camera_pins)
+        return SCHEDULE_PIN_CONFLICT;
+    uint32_t cycle_length = frame_cycle_length(table);
+    if (cycle_length == 0)
+        return SCHEDULE_BAD_FRAME_DIVISOR;
+    uint64_t cycle_period_us = 0;
+    for (uint32_t frame = 0; frame < cycle_length; ++frame)
+    {
+        uint64_t task_time_us = frame_task_time_us(table, frame);
+        if (table.fixed_frame_period_us && (task_time_us > table.fixed_frame_period_us))
+            return SCHEDULE_FRAME_OVERRUN;
+        uint64_t period_us = frame_period_us(table, frame);
+        if (period_us == 0)
+            return SCHEDULE_EMPTY_FRAME;
+        if (period_us > MAX_FRAME_PERIOD_US)
+            return SCHEDULE_FRAME_TOO_LONG;
+        cycle_period_us += period_us;
+    }
+
+    // Walk each camera's exposures in order through one frame cycle. The gap
+    // before its first exposure is the wrap-around from its last exposure in
+    // the cycle before.
+    while (camera_pins)
+    {
+        uint32_t camera_pin_bit = 1u << std::countr_zero(camera_pins);
+        camera_pins &= ~camera_pin_bit;
+        CameraExposureWalk walk;
+        uint64_t frame_start_us = 0;
+        for (uint32_t frame = 0; frame < cycle_length; ++frame)
+        {
+            size_t exposure_count = place_frame_tasks(table, frame);
+            for (size_t i = 0; i < exposure_count; ++i)
+            {
+                const LaserFIPTaskSettings& settings = table.tasks[frame_task_slots[i]];
+                uint64_t camera_on_us = frame_start_us + frame_exposures[i].camera_on_us;
+                // A muted task never raises its outputs.
+                if (settings.mute || !(settings.output_mask & camera_pin_bit))
+                    continue;
+                if (!walk.append(camera_on_us, camera_on_us + settings.delta1_us))
+                    return SCHEDULE_CAMERA_OVERLAP;
+            }
+            frame_start_us += frame_period_us(table, frame);
+        }
+        if (!walk.wraps(cycle_period_us))
+            return SCHEDULE_CAMERA_OVERLAP;
+    }
+    return SCHEDULE_OK;
+}
+
+uint32_t frame_cycle_period_us(const TaskTable& table)
+{
+    if (table.task_count == 0)
+        return 0;
+    uint64_t cycle_period_us = 0;
+    uint32_t cycle_length = frame_cycle_length(table);
+    for (uint32_t frame = 0; frame < cycle_length; ++frame)
+        cycle_period_us += frame_period_us(table, frame);
+    return (cycle_period_us > UINT32_MAX)? UINT32_MAX: uint32_t(cycle_period_us);
+}
+
+float laser_duty_fraction(const TaskTable& table, uint32_t pwm_pin_bit)
+{
+    uint32_t cycle_period_us = frame_cycle_period_us(table);
+    if (cycle_period_us == 0)
+        return 0;
+    uint32_t cycle_length = frame_cycle_length(table);
+    float on_us = 0;
+    for (size_t i = 0; i < table.task_count; ++i)
+    {
+        size_t slot = table.order[i];
+        const LaserFIPTaskSettings& settings = table.tasks[slot];
+        if (settings.pwm_pin_bit != pwm_pin_bit)
+            continue;
+        float duty_cycle = settings.pwm_duty_cycle;
+        if (duty_cycle < 0)
+            duty_cycle = 0;
+        else if (duty_cycle > 1)
+            duty_cycle = 1;
+        // Exposures of this task per cycle.
+        uint8_t divisor = table.frame_divisors[slot].divisor;
+        uint32_t exposure_count = (divisor <= 1)? cycle_length: cycle_length / divisor;
+        on_us += float(uint64_t(settings.delta3_us) + settings.delta1_us
+                       + settings.delta4_us) * duty_cycle * float(exposure_count);
+    }
+    return on_us / float(cycle_period_us);
+}
@@ -0,0 +1,158 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <config.h>
+#include <fip_ctrl_queues.h>
+
+// Enqueue cost of the rising edge event ring versus a queue_t-style locked
+// queue. Host wall-clock numbers: they compare the two designs on the same
+// machine, not what either costs on the RP2040.
+
+inline constexpr size_t PUSH_COUNT = 1'000'000;
+// Depth of the queue_t the ring replaced.
+inline constexpr uint8_t MAX_QUEUE_SIZE = 32;
+
+// Layout of the event record before the ring replaced queue_t.
+struct LegacyRisingEdgeEventData
+{
+    uint32_t output_state;
+    uint64_t time_us;
+};
+
+/**
+ * \brief the pico-sdk queue_t algorithm: every add and remove takes a
+ *  spinlock around a memcpy and the level bookkeeping. (On the RP2040 it also
+ *  disables interrupts while holding the lock, which this can't model.)
+ */
+class LockedQueue
+{
+public:
+    bool try_add(const void* data)
+    {
+        lock();
+        bool added = (count_ < MAX_QUEUE_SIZE);
+        if (added)
+        {
+            memcpy(&data_[((rd_ + count_) % MAX_QUEUE_SIZE) * sizeof(LegacyRisingEdgeEventData)],
+                   data, sizeof(LegacyRisingEdgeEventData));
+            ++count_;
+        }
+        unlock();
+        return added;
+    }
+
+    bool try_remove(void* data)
+    {
+        lock();
+        bool removed = (count_ > 0);
+        if (removed)
+        {
+            memcpy(data, &data_[rd_ * sizeof(LegacyRisingEdgeEventData)],
+                   sizeof(LegacyRisingEdgeEventData));
+            rd_ = (rd_ + 1) % MAX_QUEUE_SIZE;
+            --count_;
+        }
+        unlock();
+        return removed;
+    }
+
+    size_t level()
+    {
+        lock();
+        size_t count = count_;
+        unlock();
+        return count;
+    }
+
+private:
+    void lock()
+    {while (lock_.test_and_set(std::memory_order_acquire)) {}}
+
+    void unlock()
+    {lock_.clear(std::memory_order_release);}
+
+    std::atomic_flag lock_ = ATOMIC_FLAG_INIT;
+    uint8_t data_[MAX_QUEUE_SIZE * sizeof(LegacyRisingEdgeEventData)];
+    size_t rd_ = 0;
+    size_t count_ = 0;
+};
+
+/**
+ * \brief producer cost per push (ns). Pushes come in bursts of half the
+ *  queue, like a frame's worth of events. Between bursts the producer waits
+ *  (untimed) for the consumer to drain, so no push is dropped and only the
+ *  enqueue itself is measured.
+ * \param contended run the consumer on another thread, polling constantly as
+ *  core0 does. Otherwise drain between bursts on this thread.
+ */
+template <typename Push, typename Pop, typename Size>
+double timed_pushes(Push push, Pop pop, Size size, bool contended)
+{
+    constexpr size_t BURST = MAX_QUEUE_SIZE / 2;
+    std::atomic<bool> done{false};
+    std::thread consumer;
+    if (contended)
+        consumer = std::thread([&]()
+        {
+            while (!done.load(std::memory_order_relaxed))
+                if (!pop())
+                    std::this_thread::yield();
+        });
+    std::chrono::duration<double, std::nano> elapsed{0};
+    for (size_t index = 0; index < PUSH_COUNT; index += BURST)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t burst_index = 0; burst_index < BURST; ++burst_index)
+            push(uint32_t(index + burst_index));
+        elapsed += std::chrono::steady_clock::now() - start;
+        if (!contended)
+            while (pop()) {}
+        while (size())
+            std::this_thread::yield();
+    }
+    done.store(true, std::memory_order_relaxed);
+    if (contended)
+        consumer.join();
+    return elapsed.count() / PUSH_COUNT;
+}
+
+int main()
+{
+    static RisingEdgeEventRing ring;
+    static LockedQueue queue;
+
+    auto ring_push = [&](uint32_t index) {return ring.try_push({index, index});};
+    auto ring_pop = [&]() {RisingEdgeEventData event; return ring.try_pop(event);};
+    auto ring_size = [&]() {return ring.size();};
+    auto queue_push = [&](uint32_t index)
+    {
+        LegacyRisingEdgeEventData event{index, index};
+        return queue.try_add(&event);
+    };
+    auto queue_pop = [&]() {LegacyRisingEdgeEventData event; return queue.try_remove(&event);};
+    auto queue_size = [&]() {return queue.level();};
+
+    printf("event record:           %zu bytes (was %zu)\r\n",
+           sizeof(RisingEdgeEventData), sizeof(LegacyRisingEdgeEventData));
+    printf("pushes:                 %zu, in bursts of %u\r\n", PUSH_COUNT,
+           MAX_QUEUE_SIZE / 2);
+    for (bool contended: {false, true})
+    {
+        // A polling consumer needs a CPU of its own, as core0 has.
+        if (contended && (std::thread::hardware_concurrency() < 2))
+        {
+            printf("consumer polling:       skipped (single CPU host)\r\n");
+            continue;
+        }
+        double ring_ns = timed_pushes(ring_push, ring_pop, ring_size, contended);
+        double queue_ns = timed_pushes(queue_push, queue_pop, queue_size, contended);
+        printf("%s SPSC ring %.1f ns/push, locked queue %.1f ns/push\r\n",
+               contended? "consumer polling:      ": "consumer idle:         ",
+               ring_ns, queue_ns);
+    }
+    printf("ring overflows:         %u, high-water mark %u/%zu\r\n",
+           ring.overflow_count(), ring.high_water_mark(), ring.capacity());
+    return ring.overflow_count()? 1: 0;
+}
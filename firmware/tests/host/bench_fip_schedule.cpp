@@ -0,0 +1,175 @@
+#include <bit>
+#include <cmath>
+#include <fip_host_fixture.h>
+
+// Simulated frame timing, throughput, and event latency for the default
+// three-laser FIP waveform. Numbers come from the cost model in sim_hal.h.
+
+inline constexpr size_t FRAME_COUNT = 1000;
+
+/**
+ * \brief time (in ns) from each edge's deadline (the timer tick it is due
+ *  on) to the first output write of that edge, for one schedule backend.
+ */
+void print_edge_latency(const char* name, uint8_t backend,
+                        const std::vector<LaserFIPTaskSettings>& tasks)
+{
+    reset_fixture();
+    {
+        sim::Core0Scope core0;
+        send_core1_command(Core1Command::backend(backend));
+    }
+    update_commands();
+    load_tasks(tasks);
+    std::vector<double> latencies_ns;
+    uint32_t frame = 0;
+    while (frame_count < FRAME_COUNT)
+    {
+        run_sequence();
+        drain_events();
+        if (frame_count == frame)
+            continue;
+        // A frame finished. Match each of its edges to the trace.
+        uint64_t frame_start_cycle = (uint64_t(edge_telemetry.session_start_us)
+            + uint64_t(frame) * fip_timeline.period_us()) * sim::CYCLES_PER_US;
+        auto& trace = sim::trace();
+        size_t sample_index = 0;
+        for (auto& edge: fip_timeline)
+        {
+            uint64_t deadline_cycle = frame_start_cycle
+                                      + uint64_t(edge.offset_us) * sim::CYCLES_PER_US;
+            while ((sample_index < trace.size())
+                   && (trace[sample_index].cycle < deadline_cycle))
+                ++sample_index;
+            if (sample_index == trace.size())
+                break;
+            latencies_ns.push_back(double(trace[sample_index].cycle - deadline_cycle)
+                                   * 1000 / sim::CYCLES_PER_US);
+        }
+        sim::clear_trace();
+        ++frame;
+    }
+    stop_sequence();
+    double min_ns = latencies_ns.empty()? 0: latencies_ns[0];
+    double max_ns = min_ns;
+    double total_ns = 0;
+    for (double latency_ns: latencies_ns)
+    {
+        min_ns = std::min(min_ns, latency_ns);
+        max_ns = std::max(max_ns, latency_ns);
+        total_ns += latency_ns;
+    }
+    double mean_ns = latencies_ns.empty()? 0: total_ns / latencies_ns.size();
+    double variance = 0;
+    for (double latency_ns: latencies_ns)
+        variance += (latency_ns - mean_ns) * (latency_ns - mean_ns);
+    double stddev_ns = latencies_ns.empty()? 0: std::sqrt(variance / latencies_ns.size());
+    printf("%-24s min %.0f ns, mean %.1f ns, max %.0f ns, jitter %.0f ns p-p,"
+           " %.1f ns rms\r\n", name, min_ns, mean_ns, max_ns, max_ns - min_ns,
+           stddev_ns);
+}
+
+/**
+ * \brief time (in ns) from core0 enabling the schedule while core1 idles to
+ *  the first laser edge, for one schedule backend. Covers the wake-up, the
+ *  queue reads and the HAL calls of the start. Computing the timeline isn't
+ *  modeled.
+ */
+void print_wake_latency(const char* name, uint8_t backend,
+                        const std::vector<LaserFIPTaskSettings>& tasks)
+{
+    reset_fixture();
+    {
+        sim::Core0Scope core0;
+        send_core1_command(Core1Command::backend(backend));
+    }
+    publish_tasks(tasks);
+    run_once();
+    uint64_t enable_cycle = sim::now_cycles() + 1000 * sim::CYCLES_PER_US;
+    sim::schedule_core0(enable_cycle, []
+    {
+        send_core1_command(Core1Command::enable(true));
+    });
+    sim::clear_trace();
+    run_once(); // Sleeps until core0 enables the schedule.
+    run_once();
+    stop_sequence();
+    drain_events();
+    uint64_t first_edge_cycle = sim::next_edge(std::countr_zero(tasks[0].pwm_pin_bit),
+                                               true);
+    printf("%-24s %.0f ns\r\n", name,
+           double(first_edge_cycle - enable_cycle) * 1000 / sim::CYCLES_PER_US);
+}
+
+int main()
+{
+    reset_fixture();
+    std::vector<LaserFIPTaskSettings> tasks
+        {make_task_settings(0, 3, DELTA1, DELTA2, DELTA3, DELTA4),
+         make_task_settings(1, 3, DELTA1, DELTA2, DELTA3, DELTA4),
+         make_task_settings(2, 4, DELTA1, DELTA2, DELTA3, DELTA4)};
+    load_tasks(tasks);
+    uint64_t nominal_period_us = 0;
+    for (auto& settings: tasks)
+        nominal_period_us += settings.delta1_us + settings.delta2_us
+                             + settings.delta3_us + settings.delta4_us;
+
+    // Event latency: time from the output edge to the timestamp core1
+    // reports for it.
+    int64_t max_event_latency_us = 0;
+    int64_t total_event_latency_us = 0;
+    size_t event_count = 0;
+    uint64_t start_cycles = sim::now_cycles();
+    for (size_t frame = 0; frame < FRAME_COUNT; ++frame)
+    {
+        run_sequence();
+        auto& trace = sim::trace();
+        size_t sample_index = 0;
+        for (auto& event: drain_events())
+        {
+            while ((sample_index < trace.size())
+                   && (trace[sample_index].state() != event.output_state))
+                ++sample_index;
+            if (sample_index == trace.size())
+                break;
+            int64_t latency_us = int64_t(event.time_us)
+                - int64_t(trace[sample_index].cycle / sim::CYCLES_PER_US);
+            max_event_latency_us = std::max(max_event_latency_us, latency_us);
+            total_event_latency_us += latency_us;
+            ++event_count;
+        }
+        sim::clear_trace();
+    }
+    uint64_t elapsed_cycles = sim::now_cycles() - start_cycles;
+    double elapsed_us = double(elapsed_cycles) / sim::CYCLES_PER_US;
+    double frame_period_us = elapsed_us / FRAME_COUNT;
+
+    printf("frames:                 %zu\r\n", FRAME_COUNT);
+    printf("nominal frame period:   %llu us\r\n", (unsigned long long)nominal_period_us);
+    printf("measured frame period:  %.3f us\r\n", frame_period_us);
+    printf("frame rate:             %.3f Hz (nominal %.3f Hz)\r\n",
+           1e6 / frame_period_us, 1e6 / nominal_period_us);
+    printf("cumulative drift:       %.1f us\r\n",
+           elapsed_us - double(nominal_period_us * FRAME_COUNT));
+    printf("events per second:      %.1f\r\n", event_count / (elapsed_us / 1e6));
+    printf("event latency:          mean %.2f us, max %lld us\r\n",
+           event_count ? double(total_event_latency_us) / event_count : 0.0,
+           (long long)max_event_latency_us);
+    EdgeTelemetry telemetry;
+    edge_telemetry_snapshot.read(telemetry);
+    printf("edge lateness:          min %u us, max %u us, mean %u ns, %u misses\r\n",
+           telemetry.min_lateness_us, telemetry.max_lateness_us,
+           telemetry.mean_lateness_ns(), telemetry.deadline_miss_count);
+
+    // Deadline-to-edge latency of each backend core1 writes edges with.
+    printf("edge latency by backend:\r\n");
+    print_edge_latency("  busy-wait:", CPU_BACKEND, tasks);
+    print_edge_latency("  timer IRQ:", TIMER_IRQ_BACKEND, tasks);
+
+    // Wake-to-first-edge latency out of core1's low-power idle.
+    printf("wake-to-first-edge latency by backend:\r\n");
+    print_wake_latency("  busy-wait:", CPU_BACKEND, tasks);
+    print_wake_latency("  PIO:", PIO_BACKEND, tasks);
+    print_wake_latency("  timer IRQ:", TIMER_IRQ_BACKEND, tasks);
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include <fip_host_fixture.h>
+
+int failures = 0;
+
+queue_t core1_command_queue;
+RisingEdgeEventRing rising_edge_event_ring;
+AcquisitionEndRing acquisition_end_ring;
+TaskTableSwap task_table_swap;
+
+void reset_fixture()
+{
+    sim::reset();
+    queue_init(&core1_command_queue, sizeof(Core1Command), CORE1_COMMAND_QUEUE_SIZE);
+    core1_command_ack = core1_command_sequence;
+    stop_sequence();
+    RisingEdgeEventData event_data;
+    while (rising_edge_event_ring.try_pop(event_data)) {}
+    rising_edge_event_ring.clear_stats();
+    AcquisitionEndData end_data;
+    while (acquisition_end_ring.try_pop(end_data)) {}
+    acquisition_frame_count = 0;
+    trigger_config = {TRIGGER_NONE, 0};
+    trigger_latency_us = 0;
+    max_trigger_latency_us = 0;
+    if (task_table_swap.is_pending())
+        task_table_swap.release(NO_APPLIED_FRAME);
+    for (auto& fip_task: fip_tasks)
+        fip_task.reset();
+    fip_task_count = 0;
+    fixed_frame_period_us = 0;
+    frame_cycle_frame_count = 1;
+    fip_timeline.set_pipelined(false);
+    enabled = false;
+    schedule_backend = CPU_BACKEND;
+}
+
+LaserFIPTaskSettings make_task_settings(uint32_t laser_io, uint32_t camera_io,
+                                        uint32_t delta1_us, uint32_t delta2_us,
+                                        uint32_t delta3_us, uint32_t delta4_us)
+{
+    LaserFIPTaskSettings settings{};
+    settings.pwm_pin_bit = 1u << IO_PIN(laser_io);
+    settings.pwm_duty_cycle = 1.0f;
+    settings.pwm_frequency_hz = 10000.f;
+    settings.output_mask = 1u << IO_PIN(camera_io);
+    settings.events = 1;
+    settings.mute = 0;
+    settings.delta1_us = delta1_us;
+    settings.delta2_us = delta2_us;
+    settings.delta3_us = delta3_us;
+    settings.delta4_us = delta4_us;
+    return settings;
+}
+
+TaskTable make_task_table(const std::vector<LaserFIPTaskSettings>& tasks,
+                          uint32_t fixed_frame_period_us)
+{
+    TaskTable table{};
+    table.fixed_frame_period_us = fixed_frame_period_us;
+    for (auto& settings: tasks)
+    {
+        size_t slot = add_task_slot(table);
+        table.pwm[slot] = LaserPWMConfig::resolve(
+            settings.pwm_duty_cycle, settings.pwm_frequency_hz, SYS_CLK_HZ);
+        table.tasks[slot] = settings;
+    }
+    return table;
+}
+
+bool publish_tasks(const std::vector<LaserFIPTaskSettings>& tasks,
+                   uint32_t fixed_frame_period_us)
+{
+    return publish_table(make_task_table(tasks, fixed_frame_period_us));
+}
+
+bool publish_table(const TaskTable& table)
+{
+    sim::Core0Scope core0;
+    return task_table_swap.try_publish(table);
+}
+
+void load_tasks(const std::vector<LaserFIPTaskSettings>& tasks,
+                uint32_t fixed_frame_period_us)
+{
+    load_table(make_task_table(tasks, fixed_frame_period_us));
+}
+
+void load_table(const TaskTable& table)
+{
+    publish_table(table);
+    apply_task_table(0);
+    start_sequence();
+    sim::clear_trace();
+}
+
+std::vector<HostEvent> drain_events()
+{
+    sim::Core0Scope core0;
+    std::vector<HostEvent> events;
+    uint64_t now_us = sim::now_cycles() / sim::CYCLES_PER_US;
+    RisingEdgeEventData event_data;
+    while (rising_edge_event_ring.try_pop(event_data))
+        events.push_back({event_data.output_state,
+                          unwrap_time_us(event_data.time_us, now_us)});
+    return events;
+}
@@ -0,0 +1,85 @@
+#ifndef FIP_HOST_FIXTURE_H
+#define FIP_HOST_FIXTURE_H
+#include <cstdio>
+#include <vector>
+#include <fip_schedule.h>
+#include <fip_ctrl_queues.h>
+
+/**
+ * \brief minimal check macro. Failures are counted and reported from main.
+ */
+extern int failures;
+#define CHECK(cond) \
+    do { if (!(cond)) { ++failures; \
+        printf("%s:%d: CHECK failed: %s\r\n", __FILE__, __LINE__, #cond); } \
+    } while (0)
+
+inline constexpr uint32_t SYS_CLK_HZ = sim::CYCLES_PER_US * 1'000'000;
+
+// IO pins as core1 sees them (after the PORT_BASE offset applied on core0).
+inline constexpr uint32_t IO_PIN(uint32_t io) {return io + PORT_BASE;}
+
+// Default FIP waveform with the lasers on IO0..IO2 and cameras on IO3/IO4.
+inline constexpr uint32_t LASER_470 = 0;
+inline constexpr uint32_t LASER_415 = 1;
+inline constexpr uint32_t LASER_565 = 2;
+inline constexpr uint32_t CAM_G = 3;
+inline constexpr uint32_t CAM_R = 4;
+
+/**
+ * \brief reset the simulator, the inter-core queues, and core1 state.
+ */
+void reset_fixture();
+
+/**
+ * \brief settings for a task with a laser on one IO pin and a camera on another.
+ */
+LaserFIPTaskSettings make_task_settings(uint32_t laser_io, uint32_t camera_io,
+                                        uint32_t delta1_us, uint32_t delta2_us,
+                                        uint32_t delta3_us, uint32_t delta4_us);
+
+/**
+ * \brief a task table as core0 builds it, with every task run in every frame.
+ */
+TaskTable make_task_table(const std::vector<LaserFIPTaskSettings>& tasks,
+                          uint32_t fixed_frame_period_us = 0);
+
+/**
+ * \brief publish a task table to core1 the same way core0 does.
+ * \return false if core1 has not applied the last one yet.
+ */
+bool publish_tasks(const std::vector<LaserFIPTaskSettings>& tasks,
+                   uint32_t fixed_frame_period_us = 0);
+
+/**
+ * \brief publish_tasks() for a table built by the test.
+ */
+bool publish_table(const TaskTable& table);
+
+/**
+ * \brief hand tasks to core1 the same way core0 does, let core1 apply them,
+ *  and start the sequence as core1 does when the schedule is enabled.
+ */
+void load_tasks(const std::vector<LaserFIPTaskSettings>& tasks,
+                uint32_t fixed_frame_period_us = 0);
+
+/**
+ * \brief load_tasks() for a table built by the test.
+ */
+void load_table(const TaskTable& table);
+
+/**
+ * \brief a rising edge event with its full timestamp, as core0 sends it.
+ */
+struct HostEvent
+{
+    uint32_t output_state;
+    uint64_t time_us;
+};
+
+/**
+ * \brief pop every rising edge event core1 has pushed so far.
+ */
+std::vector<HostEvent> drain_events();
+
+#endif // FIP_HOST_FIXTURE_H
@@ -0,0 +1,36 @@
+#include <pio_edge_model.h>
+#include <pio_edge_table.h>
+
+namespace sim
+{
+std::vector<PIOOutput> run_pio_edge_program(const uint32_t* words, size_t word_count,
+                                            uint64_t start_cycle, uint64_t end_cycle)
+{
+    std::vector<PIOOutput> outputs;
+    if (word_count == 0)
+        return outputs;
+    uint64_t cycle = start_cycle;
+    uint32_t pins = 0;
+    size_t index = 0;
+    while (cycle < end_cycle)
+    {
+        // Autopull: the OSR refills from the FIFO with the next word.
+        uint32_t osr = words[index];
+        index = (index + 1) % word_count;
+        // out pins, 8
+        uint32_t new_pins = osr & ((1u << PIO_EDGE_PIN_COUNT) - 1);
+        osr >>= PIO_EDGE_PIN_COUNT;
+        if (new_pins != pins)
+            outputs.push_back({cycle, new_pins << PORT_BASE});
+        pins = new_pins;
+        cycle += 1;
+        // out x, 24
+        uint32_t x = osr;
+        cycle += 1;
+        // hold: jmp x-- hold. Jumps while x is nonzero, then falls through to
+        // the wrap.
+        cycle += uint64_t(x) + 1;
+    }
+    return outputs;
+}
+}
@@ -0,0 +1,30 @@
+#ifndef PIO_EDGE_MODEL_H
+#define PIO_EDGE_MODEL_H
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace sim
+{
+/**
+ * \brief output levels the fip_edge_engine PIO program drives, starting at
+ *  one cycle.
+ */
+struct PIOOutput
+{
+    uint64_t cycle;
+    uint32_t gpio_state;
+};
+
+/**
+ * \brief instruction-level timing model of fip_edge_engine.pio.
+ * \details runs the program over the table's words (looping forever, as the
+ *  DMA does) from start_cycle until end_cycle and returns every change to the
+ *  outputs. The PIO runs one instruction per cycle and the FIFO never runs
+ *  dry, so each instruction costs exactly one cycle.
+ */
+std::vector<PIOOutput> run_pio_edge_program(const uint32_t* words, size_t word_count,
+                                            uint64_t start_cycle, uint64_t end_cycle);
+}
+
+#endif // PIO_EDGE_MODEL_H
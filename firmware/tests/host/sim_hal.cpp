@@ -0,0 +1,376 @@
+#include <sim_hal.h>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <cstdlib>
+#include <deque>
+#include <map>
+
+namespace
+{
+uint64_t cycles_ = 0;
+sim::Costs costs_;
+uint32_t gpio_state_ = 0;
+uint32_t pwm_state_ = 0;
+std::vector<sim::OutputSample> trace_;
+sim::PWMSliceConfig pwm_configs_[32];
+size_t pwm_configure_count_ = 0;
+void (*alarm_handler_)() = nullptr;
+bool alarm_armed_ = false;
+uint32_t alarm_deadline_us_ = 0;
+void (*trigger_handler_)() = nullptr;
+std::deque<uint64_t> trigger_cycles_; // pending trigger edges, in order.
+uint32_t doorbell_ = 0;
+uint32_t doorbell_answered_ = 0;
+std::multimap<uint64_t, std::function<void()>> core0_actions_; // by cycle.
+
+void record()
+{trace_.push_back({cycles_, gpio_state_, pwm_state_});}
+
+/**
+ * \brief run the interrupt of the next trigger edge, no earlier than its cycle.
+ */
+void run_trigger_irq()
+{
+    if (trigger_cycles_.front() > cycles_)
+        cycles_ = trigger_cycles_.front();
+    trigger_cycles_.pop_front();
+    if (!trigger_handler_)
+        return;
+    cycles_ += costs_.irq_entry;
+    trigger_handler_();
+}
+
+/**
+ * \brief cycle of the next scheduled core0 action, or UINT64_MAX.
+ */
+uint64_t next_core0_cycle()
+{return core0_actions_.empty()? UINT64_MAX: core0_actions_.begin()->first;}
+
+/**
+ * \brief run the next scheduled core0 action, no earlier than its cycle.
+ */
+void run_core0_action()
+{
+    auto it = core0_actions_.begin();
+    if (it->first > cycles_)
+        cycles_ = it->first;
+    std::function<void()> action = std::move(it->second);
+    core0_actions_.erase(it);
+    sim::Core0Scope core0;
+    action();
+}
+
+/**
+ * \brief cycle on which the timer reaches deadline_us.
+ */
+uint64_t deadline_cycle(uint32_t deadline_us)
+{
+    uint64_t now_us = cycles_ / sim::CYCLES_PER_US;
+    return (now_us + int32_t(deadline_us - uint32_t(now_us))) * sim::CYCLES_PER_US;
+}
+
+/**
+ * \brief spin in a busy-wait loop until the first poll at/past target_cycle.
+ *  Trigger interrupts and core0 actions due during the wait run first.
+ * \param poll_cycles cost of one iteration of the loop.
+ */
+void poll_until(uint64_t target_cycle, uint32_t poll_cycles)
+{
+    while (true)
+    {
+        uint64_t trigger_cycle = trigger_cycles_.empty()? UINT64_MAX
+                                                        : trigger_cycles_.front();
+        uint64_t core0_cycle = next_core0_cycle();
+        if (std::min(trigger_cycle, core0_cycle) >= target_cycle)
+            break;
+        if (core0_cycle < trigger_cycle)
+            run_core0_action();
+        else
+            run_trigger_irq();
+    }
+    uint64_t polls = 1;
+    if (target_cycle > cycles_)
+        polls = (target_cycle - cycles_ + poll_cycles - 1) / poll_cycles;
+    cycles_ += polls * poll_cycles;
+}
+}
+
+namespace sim
+{
+void reset()
+{
+    cycles_ = 0;
+    costs_ = Costs();
+    gpio_state_ = 0;
+    pwm_state_ = 0;
+    trace_.clear();
+    alarm_armed_ = false;
+    trigger_handler_ = nullptr;
+    trigger_cycles_.clear();
+    doorbell_ = 0;
+    doorbell_answered_ = 0;
+    core0_actions_.clear();
+    for (auto& config: pwm_configs_)
+        config = {};
+    pwm_configure_count_ = 0;
+}
+
+Costs& costs()
+{return costs_;}
+
+uint64_t now_cycles()
+{return cycles_;}
+
+void advance_cycles(uint64_t cycles)
+{cycles_ += cycles;}
+
+Core0Scope::Core0Scope()
+:saved_cycles_{cycles_}
+{}
+
+Core0Scope::~Core0Scope()
+{cycles_ = saved_cycles_;}
+
+const std::vector<OutputSample>& trace()
+{return trace_;}
+
+void clear_trace()
+{trace_.clear();}
+
+void record_outputs(uint64_t cycle, uint32_t gpio_state)
+{
+    gpio_state_ = gpio_state;
+    trace_.push_back({cycle, gpio_state_, pwm_state_});
+}
+
+uint64_t next_edge(uint32_t pin, bool level, uint64_t start_cycle)
+{
+    uint32_t prev_state = 0;
+    for (auto& sample: trace_)
+    {
+        bool was_set = (prev_state >> pin) & 1u;
+        bool is_set = (sample.state() >> pin) & 1u;
+        prev_state = sample.state();
+        if (sample.cycle < start_cycle)
+            continue;
+        if ((was_set != is_set) && (is_set == level))
+            return sample.cycle;
+    }
+    return UINT64_MAX;
+}
+
+std::vector<uint64_t> rising_edges(uint32_t pin)
+{
+    std::vector<uint64_t> edges;
+    uint64_t cycle = 0;
+    while ((cycle = next_edge(pin, true, cycle)) != UINT64_MAX)
+        edges.push_back(cycle++);
+    return edges;
+}
+
+PWMSliceConfig pwm_config(uint32_t pin)
+{return pwm_configs_[pin];}
+
+size_t pwm_configure_count()
+{return pwm_configure_count_;}
+
+void schedule_trigger(uint64_t cycle)
+{trigger_cycles_.push_back(cycle);}
+
+void schedule_core0(uint64_t cycle, std::function<void()> action)
+{core0_actions_.emplace(cycle, std::move(action));}
+}
+
+uint32_t hal_time_us_32()
+{
+    cycles_ += costs_.timer_read;
+    return uint32_t(cycles_ / sim::CYCLES_PER_US);
+}
+
+uint64_t hal_time_us_64()
+{
+    cycles_ += 2 * costs_.timer_read;
+    return cycles_ / sim::CYCLES_PER_US;
+}
+
+uint32_t hal_busy_wait_until_us_32(uint32_t deadline_us)
+{
+    // The loop exits on the first poll that reads a time at/past the deadline.
+    poll_until(deadline_cycle(deadline_us), costs_.poll_loop);
+    return uint32_t(cycles_ / sim::CYCLES_PER_US);
+}
+
+uint32_t hal_busy_wait_until_us_32_or_doorbell(uint32_t deadline_us)
+{
+    // Each poll also reads the doorbell. Core0 can only ring it from a
+    // scheduled action.
+    uint32_t poll_cycles = costs_.poll_loop + costs_.flag_read;
+    uint64_t target_cycle = deadline_cycle(deadline_us);
+    while ((doorbell_ == doorbell_answered_) && (next_core0_cycle() < target_cycle))
+    {
+        poll_until(next_core0_cycle(), poll_cycles);
+        run_core0_action();
+    }
+    if (doorbell_ != doorbell_answered_)
+        cycles_ += poll_cycles; // The poll that sees it.
+    else
+        poll_until(target_cycle, poll_cycles);
+    return uint32_t(cycles_ / sim::CYCLES_PER_US);
+}
+
+void hal_alarm_init(void (*handler)())
+{alarm_handler_ = handler;}
+
+void hal_alarm_disarm()
+{
+    cycles_ += costs_.timer_read;
+    alarm_armed_ = false;
+}
+
+bool hal_alarm_arm(uint32_t deadline_us)
+{
+    cycles_ += 2 * costs_.timer_read;
+    alarm_armed_ = int32_t(deadline_us - uint32_t(cycles_ / sim::CYCLES_PER_US)) > 0;
+    alarm_deadline_us_ = deadline_us;
+    return alarm_armed_;
+}
+
+void hal_alarm_clear()
+{cycles_ += costs_.timer_read;}
+
+void hal_trigger_init(uint32_t, void (*handler)())
+{trigger_handler_ = handler;}
+
+void hal_trigger_deinit(uint32_t)
+{trigger_handler_ = nullptr;}
+
+void hal_wait_for_event()
+{
+    // The alarm fires on the cycle the timer reaches the deadline.
+    uint64_t fire_cycle = alarm_armed_? deadline_cycle(alarm_deadline_us_): UINT64_MAX;
+    uint64_t core0_cycle = next_core0_cycle();
+    if ((core0_cycle < fire_cycle)
+        && (trigger_cycles_.empty() || (core0_cycle <= trigger_cycles_.front())))
+    {
+        // Core0's SEV wakes core1 as fast as an interrupt would.
+        run_core0_action();
+        cycles_ += costs_.irq_entry;
+        return;
+    }
+    if (!trigger_cycles_.empty() && (trigger_cycles_.front() < fire_cycle))
+    {
+        run_trigger_irq();
+        return;
+    }
+    if (!alarm_armed_)
+        return;
+    if (fire_cycle > cycles_)
+        cycles_ = fire_cycle;
+    cycles_ += costs_.irq_entry;
+    alarm_armed_ = false;
+    alarm_handler_();
+}
+
+void hal_send_event()
+{}
+
+void hal_doorbell_ring(uint32_t sequence)
+{doorbell_ = sequence;}
+
+uint32_t hal_doorbell_sequence()
+{
+    cycles_ += costs_.flag_read;
+    return doorbell_;
+}
+
+bool hal_doorbell_rung()
+{return hal_doorbell_sequence() != doorbell_answered_;}
+
+void hal_doorbell_answer(uint32_t sequence)
+{doorbell_answered_ = sequence;}
+
+void hal_gpio_put_masked(uint32_t mask, uint32_t value)
+{
+    cycles_ += costs_.gpio_write;
+    uint32_t new_state = (gpio_state_ & ~mask) | (value & mask);
+    if (new_state == gpio_state_)
+        return;
+    gpio_state_ = new_state;
+    record();
+}
+
+void hal_gpio_init_outputs(uint32_t mask)
+{hal_gpio_put_masked(mask, 0);}
+
+void hal_pwm_configure(uint32_t pin, uint16_t clkdiv_x16, uint16_t wrap,
+                       uint16_t level)
+{
+    cycles_ += costs_.pwm_config;
+    pwm_configs_[pin] = {clkdiv_x16, wrap, level};
+    ++pwm_configure_count_;
+}
+
+void hal_pwm_put_masked(uint32_t mask, uint32_t value)
+{
+    cycles_ += uint64_t(std::popcount(mask)) * costs_.pwm_mux;
+    uint32_t new_state = (pwm_state_ & ~mask) | (value & mask);
+    if (new_state == pwm_state_)
+        return;
+    pwm_state_ = new_state;
+    record();
+}
+
+void queue_init(queue_t* q, unsigned int element_size, unsigned int element_count)
+{
+    q->data.assign(size_t(element_size) * element_count, 0);
+    q->element_size = element_size;
+    q->capacity = element_count;
+    q->rd = 0;
+    q->count = 0;
+}
+
+void queue_free(queue_t* q)
+{
+    q->data.clear();
+    q->capacity = 0;
+    q->count = 0;
+}
+
+unsigned int queue_get_level(queue_t* q)
+{return q->count;}
+
+bool queue_is_empty(queue_t* q)
+{return q->count == 0;}
+
+bool queue_is_full(queue_t* q)
+{return q->count == q->capacity;}
+
+bool queue_try_add(queue_t* q, const void* data)
+{
+    cycles_ += costs_.queue_op;
+    if (q->count == q->capacity)
+        return false;
+    size_t wr = (q->rd + q->count) % q->capacity;
+    memcpy(&q->data[wr * q->element_size], data, q->element_size);
+    ++q->count;
+    return true;
+}
+
+bool queue_try_remove(queue_t* q, void* data)
+{
+    cycles_ += costs_.queue_op;
+    if (q->count == 0)
+        return false;
+    memcpy(data, &q->data[q->rd * q->element_size], q->element_size);
+    q->rd = (q->rd + 1) % q->capacity;
+    --q->count;
+    return true;
+}
+
+void queue_remove_blocking(queue_t* q, void* data)
+{
+    // Nothing else runs in the simulation, so an empty queue would block forever.
+    if (!queue_try_remove(q, data))
+        abort();
+}
@@ -0,0 +1,170 @@
+#ifndef SIM_HAL_H
+#define SIM_HAL_H
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <functional>
+
+/**
+ * Host backend for fip_hal.h.
+ *
+ * Time is kept in simulated system clock cycles. Every HAL call advances the
+ * clock by a configurable cost that models what the call takes on the RP2040,
+ * so latencies accumulate the same way they would on core1. Every change to
+ * an output pin is recorded in a trace for tests and benchmarks to inspect.
+ */
+namespace sim
+{
+inline constexpr uint64_t CYCLES_PER_US = 125;
+
+/**
+ * \brief modeled cost (in system clock cycles) of each HAL operation.
+ */
+struct Costs
+{
+    uint32_t timer_read = 4;    /// APB register read.
+    uint32_t poll_loop = 8;     /// one iteration of a busy-wait loop.
+    uint32_t gpio_write = 4;    /// SIO register write.
+    uint32_t pwm_config = 16;   /// a PWM slice's divider, wrap, level and enable writes.
+    uint32_t pwm_mux = 12;      /// switching one pin's gpio function.
+    uint32_t queue_op = 120;    /// spinlock + memcpy inside queue_t.
+    uint32_t irq_entry = 15;    /// exception entry, from alarm to handler.
+    uint32_t flag_read = 2;     /// load of a flag shared with core0.
+};
+
+/**
+ * \brief output state at one point in the trace.
+ */
+struct OutputSample
+{
+    uint64_t cycle;
+    uint32_t gpio_state;    /// pins driven high by SIO.
+    uint32_t pwm_state;     /// pins with their PWM output enabled.
+
+    uint32_t state() const {return gpio_state | pwm_state;}
+};
+
+void reset();
+Costs& costs();
+uint64_t now_cycles();
+void advance_cycles(uint64_t cycles);
+
+/**
+ * \brief work done inside this scope (core0's side of the queues, test
+ *  bookkeeping) does not advance core1's clock.
+ */
+class Core0Scope
+{
+public:
+    Core0Scope();
+    ~Core0Scope();
+private:
+    uint64_t saved_cycles_;
+};
+
+/**
+ * \brief every change to the outputs, in order.
+ */
+const std::vector<OutputSample>& trace();
+void clear_trace();
+
+/**
+ * \brief append output state driven by something other than core1 (i.e: the
+ *  PIO) to the trace.
+ */
+void record_outputs(uint64_t cycle, uint32_t gpio_state);
+
+/**
+ * \brief cycle at which pin was next driven to level at or after start_cycle
+ *  or UINT64_MAX if it never was.
+ */
+uint64_t next_edge(uint32_t pin, bool level, uint64_t start_cycle = 0);
+
+/**
+ * \brief cycles at which pin rose, in order.
+ */
+std::vector<uint64_t> rising_edges(uint32_t pin);
+
+/**
+ * \brief PWM slice registers last written for a pin.
+ */
+struct PWMSliceConfig
+{
+    uint16_t clkdiv_x16;
+    uint16_t wrap;
+    uint16_t level;
+};
+PWMSliceConfig pwm_config(uint32_t pin);
+
+/**
+ * \brief PWM slice configurations written since reset().
+ */
+size_t pwm_configure_count();
+
+/**
+ * \brief raise a rising edge on the trigger input at cycle. Its interrupt
+ *  runs when core1 sleeps or busy-waits past that cycle.
+ */
+void schedule_trigger(uint64_t cycle);
+
+/**
+ * \brief run action as core0 at cycle (i.e: a queue write) without advancing
+ *  core1's clock. It runs when core1 sleeps or busy-waits past that cycle,
+ *  and wakes core1 from hal_wait_for_event() like core0's SEV would.
+ */
+void schedule_core0(uint64_t cycle, std::function<void()> action);
+}
+
+inline uint32_t hal_cycles_per_us() {return sim::CYCLES_PER_US;}
+uint32_t hal_time_us_32();
+uint64_t hal_time_us_64();
+uint32_t hal_busy_wait_until_us_32(uint32_t deadline_us);
+void hal_alarm_init(void (*handler)());
+void hal_alarm_disarm();
+bool hal_alarm_arm(uint32_t deadline_us);
+void hal_alarm_clear();
+void hal_trigger_init(uint32_t pin, void (*handler)());
+void hal_trigger_deinit(uint32_t pin);
+/**
+ * \brief run the handler of the alarm or the trigger input, whichever
+ *  interrupts first, as if core1 slept until it fired. Return early if a
+ *  scheduled core0 action runs first. Otherwise return at once, as if core0
+ *  woke core1.
+ */
+void hal_wait_for_event();
+void hal_send_event();
+void hal_doorbell_ring(uint32_t sequence);
+uint32_t hal_doorbell_sequence();
+bool hal_doorbell_rung();
+void hal_doorbell_answer(uint32_t sequence);
+uint32_t hal_busy_wait_until_us_32_or_doorbell(uint32_t deadline_us);
+void hal_gpio_put_masked(uint32_t mask, uint32_t value);
+void hal_gpio_init_outputs(uint32_t mask);
+void hal_pwm_configure(uint32_t pin, uint16_t clkdiv_x16, uint16_t wrap,
+                       uint16_t level);
+void hal_pwm_put_masked(uint32_t mask, uint32_t value);
+
+inline void tight_loop_contents() {}
+
+/**
+ * \brief host stand-in for the pico-sdk queue_t.
+ */
+struct queue_t
+{
+    std::vector<uint8_t> data;
+    size_t element_size = 0;
+    size_t capacity = 0;
+    size_t rd = 0;
+    size_t count = 0;
+};
+
+void queue_init(queue_t* q, unsigned int element_size, unsigned int element_count);
+void queue_free(queue_t* q);
+unsigned int queue_get_level(queue_t* q);
+bool queue_is_empty(queue_t* q);
+bool queue_is_full(queue_t* q);
+bool queue_try_add(queue_t* q, const void* data);
+bool queue_try_remove(queue_t* q, void* data);
+void queue_remove_blocking(queue_t* q, void* data);
+
+#endif // SIM_HAL_H
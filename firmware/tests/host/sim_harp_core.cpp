@@ -0,0 +1,52 @@
+#include <harp_core.h>
+#include <cstring>
+#include <cuttlefish_fip_app.h>
+
+namespace
+{
+std::vector<sim::HarpReply> replies_;
+op_mode_t op_mode_ = ACTIVE;
+}
+
+void HarpCore::read_reg_generic(uint8_t reg_name)
+{send_harp_reply(READ, reg_name);}
+
+void HarpCore::write_to_read_only_reg_error(msg_t& msg)
+{send_harp_reply(WRITE_ERROR, msg.header.address);}
+
+void HarpCore::send_harp_reply(msg_type_t reply_type, uint8_t reg_name)
+{replies_.push_back({reply_type, reg_name});}
+
+void HarpCore::send_harp_reply(msg_type_t reply_type, uint8_t reg_name,
+                               uint64_t)
+{replies_.push_back({reply_type, reg_name});}
+
+void HarpCore::copy_msg_payload_to_register(msg_t& msg)
+{
+    const RegSpecs& specs = app_reg_specs()[msg.header.address - APP_REG_START_ADDRESS];
+    memcpy(specs.base_ptr, msg.payload, specs.num_bytes);
+}
+
+bool HarpCore::is_muted()
+{return false;}
+
+op_mode_t HarpCore::get_op_mode()
+{return op_mode_;}
+
+uint64_t HarpCore::system_to_harp_us_64(uint64_t system_time_us)
+{return system_time_us;}
+
+uint64_t HarpCore::harp_to_system_us_64(uint64_t harp_time_us)
+{return harp_time_us;}
+
+namespace sim
+{
+const std::vector<HarpReply>& harp_replies()
+{return replies_;}
+
+void clear_harp_replies()
+{replies_.clear();}
+
+void set_op_mode(op_mode_t mode)
+{op_mode_ = mode;}
+}
@@ -0,0 +1,45 @@
+#include <pio_edge_engine.h>
+#include <pio_edge_model.h>
+#include <sim_hal.h>
+
+// Host stand-in for pio_edge_engine.cpp. The PIO runs in parallel with core1,
+// so its outputs are computed with the PIO program model and added to the
+// trace when the engine stops.
+
+namespace
+{
+uint64_t start_cycle_ = 0;
+}
+
+void PIOEdgeEngine::init()
+{initialized_ = true;}
+
+void PIOEdgeEngine::load(const PIOEdgeTable& table)
+{
+    init();
+    table_ = &table;
+    table_words_ = table.words();
+    pin_mask_ = table.pin_mask();
+    hal_gpio_put_masked(pin_mask_, 0);
+}
+
+void PIOEdgeEngine::start()
+{
+    start_cycle_ = sim::now_cycles();
+    running_ = true;
+}
+
+void PIOEdgeEngine::stop()
+{
+    if (!table_)
+        return;
+    if (running_)
+    {
+        for (auto& output: sim::run_pio_edge_program(table_words_, table_->word_count(),
+                                                     start_cycle_, sim::now_cycles()))
+            sim::record_outputs(output.cycle, output.gpio_state);
+    }
+    hal_gpio_init_outputs(pin_mask_);
+    table_ = nullptr;
+    running_ = false;
+}
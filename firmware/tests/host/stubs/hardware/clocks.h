@@ -0,0 +1,10 @@
+#ifndef STUBS_HARDWARE_CLOCKS_H
+#define STUBS_HARDWARE_CLOCKS_H
+#include <cstdint>
+#include <sim_hal.h>
+
+// Host stand-in: the system clock runs at the simulator's rate.
+enum clock_index {clk_sys = 5};
+inline uint32_t clock_get_hz(clock_index) {return sim::CYCLES_PER_US * 1'000'000;}
+
+#endif // STUBS_HARDWARE_CLOCKS_H
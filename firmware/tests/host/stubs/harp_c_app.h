@@ -0,0 +1,8 @@
+#ifndef STUBS_HARP_C_APP_H
+#define STUBS_HARP_C_APP_H
+#include <harp_core.h>
+
+// Host stand-in. The app's registers are reached through app_reg_specs().
+class HarpCApp: public HarpCore {};
+
+#endif // STUBS_HARP_C_APP_H
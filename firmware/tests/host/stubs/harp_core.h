@@ -0,0 +1,72 @@
+#ifndef STUBS_HARP_CORE_H
+#define STUBS_HARP_CORE_H
+#include <cstdint>
+#include <vector>
+#include <harp_message.h>
+
+// Host stand-in for the Harp core: replies are recorded instead of sent (see
+// sim_harp_core.cpp), and Harp time is system time.
+
+#define APP_REG_START_ADDRESS (32)
+
+enum op_mode_t: uint8_t
+{
+    STANDBY = 0,
+    ACTIVE = 1
+};
+
+struct RegSpecs
+{
+    uint8_t* base_ptr;
+    uint8_t num_bytes;
+    reg_type_t payload_type;
+};
+
+typedef void (*read_reg_fn)(uint8_t reg_name);
+typedef void (*write_reg_fn)(msg_t& msg);
+
+struct RegFnPair
+{
+    read_reg_fn read_fn_ptr;
+    write_reg_fn write_fn_ptr;
+};
+
+class HarpCore
+{
+public:
+    static void read_reg_generic(uint8_t reg_name);
+    static void write_to_read_only_reg_error(msg_t& msg);
+    static void send_harp_reply(msg_type_t reply_type, uint8_t reg_name);
+    static void send_harp_reply(msg_type_t reply_type, uint8_t reg_name,
+                                uint64_t harp_time_us);
+    static void copy_msg_payload_to_register(msg_t& msg);
+    static bool is_muted();
+    static op_mode_t get_op_mode();
+    static uint64_t system_to_harp_us_64(uint64_t system_time_us);
+    static uint64_t harp_to_system_us_64(uint64_t harp_time_us);
+};
+
+namespace sim
+{
+/**
+ * \brief a reply core0 sent to the Harp host.
+ */
+struct HarpReply
+{
+    msg_type_t type;
+    uint8_t address;
+};
+
+/**
+ * \brief every reply sent since the last clear_harp_replies().
+ */
+const std::vector<HarpReply>& harp_replies();
+void clear_harp_replies();
+
+/**
+ * \brief the operation mode HarpCore::get_op_mode() reports.
+ */
+void set_op_mode(op_mode_t mode);
+}
+
+#endif // STUBS_HARP_CORE_H
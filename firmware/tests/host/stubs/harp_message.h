@@ -0,0 +1,45 @@
+#ifndef STUBS_HARP_MESSAGE_H
+#define STUBS_HARP_MESSAGE_H
+#include <cstdint>
+
+// Host stand-in for the Harp message types core0's register handlers use.
+
+enum msg_type_t: uint8_t
+{
+    READ = 1,
+    WRITE = 2,
+    EVENT = 3,
+    READ_ERROR = 9,
+    WRITE_ERROR = 10
+};
+
+enum reg_type_t: uint8_t
+{
+    U8 = 1,
+    S8 = 129,
+    U16 = 2,
+    S16 = 130,
+    U32 = 4,
+    S32 = 132,
+    U64 = 8,
+    S64 = 136,
+    Float = 68
+};
+
+struct msg_header_t
+{
+    msg_type_t type;
+    uint8_t raw_length;
+    uint8_t address;
+    uint8_t port;
+    reg_type_t payload_type;
+};
+
+struct msg_t
+{
+    msg_header_t header;
+    void* payload;
+    uint8_t checksum;
+};
+
+#endif // STUBS_HARP_MESSAGE_H
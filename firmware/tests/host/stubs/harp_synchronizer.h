@@ -0,0 +1,4 @@
+#ifndef STUBS_HARP_SYNCHRONIZER_H
+#define STUBS_HARP_SYNCHRONIZER_H
+// Host stand-in. Harp time is system time (see harp_core.h).
+#endif // STUBS_HARP_SYNCHRONIZER_H
@@ -0,0 +1,4 @@
+#ifndef STUBS_PICO_MULTICORE_H
+#define STUBS_PICO_MULTICORE_H
+// Host stand-in. The host tests run both cores' code on one thread.
+#endif // STUBS_PICO_MULTICORE_H
@@ -0,0 +1,14 @@
+#ifndef STUBS_PICO_STDLIB_H
+#define STUBS_PICO_STDLIB_H
+#include <cstdint>
+#include <sim_hal.h>
+
+// Host stand-in for the pico-sdk calls core0's app makes directly. The bus
+// switch GPIOs aren't modeled.
+
+inline uint64_t time_us_64() {return hal_time_us_64();}
+inline void gpio_init_mask(uint32_t) {}
+inline void gpio_set_dir_masked(uint32_t, uint32_t) {}
+inline void gpio_put_masked(uint32_t, uint32_t) {}
+
+#endif // STUBS_PICO_STDLIB_H
@@ -0,0 +1,273 @@
+#include <cuttlefish_fip_app.h>
+#include <fip_host_fixture.h>
+
+// core0's register handlers, driven with the messages a Harp host sends. The
+// Harp core and the pico-sdk calls they make are stand-ins (see stubs/).
+
+/**
+ * \brief reset the simulator and core1, then reset the app the way Harp does,
+ *  and let core1 take the empty table and settings it sends.
+ */
+void reset_app_fixture()
+{
+    reset_fixture();
+    {
+        sim::Core0Scope core0;
+        reset_app();
+    }
+    update_commands();
+    apply_task_table(0);
+}
+
+/**
+ * \brief send a write message to the handler of the register at address.
+ * \return the type of the handler's only reply (READ_ERROR if it sent none).
+ */
+template <typename T>
+msg_type_t write_reg(uint8_t address, T payload)
+{
+    msg_t msg{{WRITE, uint8_t(sizeof(T) + 5), address, 255, U8}, &payload, 0};
+    sim::clear_harp_replies();
+    {
+        sim::Core0Scope core0;
+        reg_handler_fns[address - APP_REG_START_ADDRESS].write_fn_ptr(msg);
+    }
+    const auto& replies = sim::harp_replies();
+    CHECK(replies.size() == 1);
+    if (replies.empty())
+        return READ_ERROR;
+    CHECK(replies.back().address == address);
+    return replies.back().type;
+}
+
+/**
+ * \brief task settings as the Harp host writes them, on IO pins (before the
+ *  PORT_BASE offset).
+ */
+LaserFIPTaskSettings host_task_settings(uint32_t laser_io, uint32_t camera_io)
+{
+    LaserFIPTaskSettings settings
+        = make_task_settings(laser_io, camera_io, DELTA1, DELTA2, DELTA3, DELTA4);
+    settings.pwm_pin_bit = 1u << laser_io;
+    settings.output_mask = 1u << camera_io;
+    return settings;
+}
+
+/**
+ * \brief one LaserTaskTable page of a table of task_count tasks that repeat
+ *  the default FIP waveform.
+ */
+LaserTaskTableData table_page(uint8_t task_count, size_t page = 0)
+{
+    const uint32_t lasers[] = {LASER_470, LASER_415, LASER_565};
+    const uint32_t cameras[] = {CAM_G, CAM_G, CAM_R};
+    LaserTaskTableData data{};
+    data.task_count = task_count;
+    for (size_t i = 0; i < LASER_TASK_TABLE_PAGE_SIZE; ++i)
+    {
+        size_t task = page * LASER_TASK_TABLE_PAGE_SIZE + i;
+        if (task >= task_count)
+            break;
+        data.tasks[i] = {uint8_t(1u << lasers[task % 3]),
+                         uint8_t(1u << cameras[task % 3]), 1, 0, 1.0f, 10000.f,
+                         DELTA1, DELTA2, DELTA3, DELTA4};
+    }
+    return data;
+}
+
+void test_laser_task_table_writes()
+{
+    reset_app_fixture();
+    // A table replaces every task in one write, and is handed to core1 whole.
+    CHECK(write_reg(LaserTaskTable, table_page(3)) == WRITE);
+    CHECK(app_regs.TaskScheduleError == SCHEDULE_OK);
+    CHECK(app_regs.LaserTaskCount == 3);
+    CHECK(app_regs.LaserTaskOrder[2] == 2);
+    CHECK(app_regs.LaserTaskOrder[3] == NO_TASK_SLOT);
+    CHECK(app_regs.ReconfigureLaserTask[2].pwm_pin_bit == 1u << IO_PIN(LASER_565));
+    CHECK(app_regs.ReconfigureLaserTask[2].output_mask == 1u << IO_PIN(CAM_R));
+    CHECK(task_table_swap.is_pending());
+    apply_task_table(0);
+    CHECK(fip_task_count == 3);
+
+    // Rejected tables leave the tasks as they were.
+    LaserTaskTableData data = table_page(3);
+    data.tasks[1].pwm_pin_bit = (1u << LASER_415) | (1u << LASER_565);
+    CHECK(write_reg(LaserTaskTable, data) == WRITE_ERROR);
+    data = table_page(3);
+    data.tasks[2].output_mask |= 1u << LASER_470;
+    CHECK(write_reg(LaserTaskTable, data) == WRITE_ERROR);
+    CHECK(app_regs.TaskScheduleError == SCHEDULE_PIN_CONFLICT);
+    data = table_page(3);
+    data.task_count = MAX_TASK_COUNT + 1;
+    CHECK(write_reg(LaserTaskTable, data) == WRITE_ERROR);
+    CHECK(app_regs.LaserTaskCount == 3);
+    CHECK(app_regs.ReconfigureLaserTask[2].output_mask == 1u << IO_PIN(CAM_R));
+    CHECK(!task_table_swap.is_pending());
+
+    // An empty table is only accepted while the schedule is disabled.
+    CHECK(write_reg(EnableTaskSchedule, uint8_t(1)) == WRITE);
+    CHECK(write_reg(LaserTaskTable, table_page(0)) == WRITE_ERROR);
+    CHECK(app_regs.LaserTaskCount == 3);
+    CHECK(write_reg(EnableTaskSchedule, uint8_t(0)) == WRITE);
+    CHECK(write_reg(LaserTaskTable, table_page(0)) == WRITE);
+    CHECK(app_regs.LaserTaskCount == 0);
+    CHECK(app_regs.LaserTaskOrder[0] == NO_TASK_SLOT);
+
+    if constexpr (LASER_TASK_TABLE_PAGE_COUNT > 1)
+    {
+        const uint8_t second_page = EXTRA_LASER_TASK_TABLE_BASE_ADDRESS;
+        const uint8_t task_count = LASER_TASK_TABLE_PAGE_SIZE + 1;
+        // A later page only continues the table its first page started.
+        CHECK(write_reg(second_page, table_page(task_count, 1)) == WRITE_ERROR);
+        CHECK(write_reg(LaserTaskTable, table_page(task_count)) == WRITE);
+        CHECK(app_regs.LaserTaskCount == 0);
+        CHECK(write_reg(second_page, table_page(task_count - 1, 1)) == WRITE_ERROR);
+        CHECK(app_regs.LaserTaskCount == 0);
+        // The table is applied once its last page arrives.
+        CHECK(write_reg(LaserTaskTable, table_page(task_count)) == WRITE);
+        CHECK(write_reg(second_page, table_page(task_count, 1)) == WRITE);
+        CHECK(app_regs.LaserTaskCount == task_count);
+        CHECK(app_regs.LaserTaskOrder[task_count - 1] == task_count - 1);
+        CHECK(app_regs.ReconfigureLaserTask[task_count - 1].pwm_pin_bit
+              == 1u << IO_PIN(LASER_565));
+        // A page past the end of the table is rejected.
+        CHECK(write_reg(LaserTaskTable, table_page(3)) == WRITE);
+        CHECK(write_reg(second_page, table_page(3, 1)) == WRITE_ERROR);
+        CHECK(app_regs.LaserTaskCount == 3);
+    }
+}
+
+void test_task_table_edits()
+{
+    reset_app_fixture();
+    CHECK(write_reg(AddLaserTask, host_task_settings(LASER_470, CAM_G)) == WRITE);
+    CHECK(write_reg(AddLaserTask, host_task_settings(LASER_415, CAM_G)) == WRITE);
+    CHECK(app_regs.LaserTaskCount == 2);
+    CHECK(app_regs.LaserTaskOrder[1] == 1);
+    CHECK(app_regs.ReconfigureLaserTask[1].pwm_pin_bit == 1u << IO_PIN(LASER_415));
+    CHECK(app_regs.PredictedFramePeriod == 2 * (DELTA1 + DELTA2 + DELTA3 + DELTA4));
+
+    // A laser on another task's camera output doesn't fit the schedule.
+    CHECK(write_reg(AddLaserTask, host_task_settings(CAM_G, CAM_R)) == WRITE_ERROR);
+    CHECK(app_regs.TaskScheduleError == SCHEDULE_PIN_CONFLICT);
+    CHECK(app_regs.LaserTaskCount == 2);
+    CHECK(app_regs.LaserTaskOrder[2] == NO_TASK_SLOT);
+    CHECK(app_regs.PredictedFramePeriod == 2 * (DELTA1 + DELTA2 + DELTA3 + DELTA4));
+
+    // Removing a task frees its slot, and the others keep theirs.
+    CHECK(write_reg(RemoveLaserTask, uint8_t(MAX_TASK_COUNT - 1)) == WRITE_ERROR);
+    CHECK(write_reg(RemoveLaserTask, uint8_t(0)) == WRITE);
+    CHECK(app_regs.TaskScheduleError == SCHEDULE_OK);
+    CHECK(app_regs.LaserTaskCount == 1);
+    CHECK(app_regs.LaserTaskOrder[0] == 1);
+    CHECK(app_regs.ReconfigureLaserTask[0].pwm_pin_bit == 0);
+    // A new task takes the free slot, and runs last.
+    CHECK(write_reg(AddLaserTask, host_task_settings(LASER_565, CAM_R)) == WRITE);
+    CHECK(app_regs.LaserTaskOrder[0] == 1);
+    CHECK(app_regs.LaserTaskOrder[1] == 0);
+    CHECK(app_regs.ReconfigureLaserTask[0].pwm_pin_bit == 1u << IO_PIN(LASER_565));
+
+    // Tasks can't be added or removed while the schedule runs.
+    CHECK(write_reg(EnableTaskSchedule, uint8_t(1)) == WRITE);
+    CHECK(write_reg(AddLaserTask, host_task_settings(LASER_470, CAM_G)) == WRITE_ERROR);
+    CHECK(write_reg(RemoveLaserTask, uint8_t(0)) == WRITE_ERROR);
+    CHECK(write_reg(RemoveAllLaserTasks, uint8_t(1)) == WRITE_ERROR);
+    CHECK(app_regs.LaserTaskCount == 2);
+    CHECK(write_reg(EnableTaskSchedule, uint8_t(0)) == WRITE);
+    CHECK(write_reg(RemoveAllLaserTasks, uint8_t(1)) == WRITE);
+    CHECK(app_regs.LaserTaskCount == 0);
+}
+
+void test_trigger_pin_checks()
+{
+    reset_app_fixture();
+    const uint32_t TRIGGER_IO = 6;
+    // There is no pin to trigger from yet, and the pin is one IO pin.
+    CHECK(write_reg(TriggerMode, uint8_t(TRIGGER_START)) == WRITE_ERROR);
+    CHECK(write_reg(TriggerPin, uint8_t(0)) == WRITE_ERROR);
+    CHECK(write_reg(TriggerPin, uint8_t((1u << TRIGGER_IO) | 1u)) == WRITE_ERROR);
+    CHECK(app_regs.TriggerMode == TRIGGER_NONE);
+    CHECK(app_regs.TriggerPin == 0);
+
+    // The pin can't be one a task drives.
+    CHECK(write_reg(AddLaserTask, host_task_settings(LASER_470, CAM_G)) == WRITE);
+    CHECK(write_reg(TriggerPin, uint8_t(1u << CAM_G)) == WRITE_ERROR);
+    CHECK(write_reg(TriggerPin, uint8_t(1u << LASER_470)) == WRITE_ERROR);
+    CHECK(app_regs.TriggerPin == 0);
+    CHECK(write_reg(TriggerPin, uint8_t(1u << TRIGGER_IO)) == WRITE);
+    CHECK(app_regs.TriggerPin == 1u << TRIGGER_IO);
+
+    // Without a trigger, a task may take the pin, but then the trigger can't
+    // be turned on.
+    CHECK(write_reg(AddLaserTask, host_task_settings(LASER_415, TRIGGER_IO)) == WRITE);
+    CHECK(app_regs.LaserTaskCount == 2);
+    CHECK(write_reg(TriggerMode, uint8_t(TRIGGER_START)) == WRITE_ERROR);
+    CHECK(write_reg(TriggerMode, uint8_t(TRIGGER_EACH_FRAME)) == WRITE_ERROR);
+    CHECK(app_regs.TriggerMode == TRIGGER_NONE);
+    CHECK(write_reg(RemoveLaserTask, uint8_t(1)) == WRITE);
+    CHECK(write_reg(TriggerMode, uint8_t(TRIGGER_START)) == WRITE);
+    CHECK(app_regs.TriggerMode == TRIGGER_START);
+
+    // With a trigger on, no task or table may take the pin.
+    CHECK(write_reg(AddLaserTask, host_task_settings(LASER_415, TRIGGER_IO)) == WRITE_ERROR);
+    CHECK(app_regs.TaskScheduleError == SCHEDULE_PIN_CONFLICT);
+    LaserTaskTableData data = table_page(3);
+    data.tasks[1].output_mask = 1u << TRIGGER_IO;
+    CHECK(write_reg(LaserTaskTable, data) == WRITE_ERROR);
+    CHECK(app_regs.TaskScheduleError == SCHEDULE_PIN_CONFLICT);
+    CHECK(app_regs.LaserTaskCount == 1);
+
+    // Neither changes while the schedule runs.
+    CHECK(write_reg(EnableTaskSchedule, uint8_t(1)) == WRITE);
+    CHECK(write_reg(TriggerMode, uint8_t(TRIGGER_NONE)) == WRITE_ERROR);
+    CHECK(write_reg(TriggerPin, uint8_t(1u << 7)) == WRITE_ERROR);
+    CHECK(write_reg(EnableTaskSchedule, uint8_t(0)) == WRITE);
+    CHECK(app_regs.TriggerMode == TRIGGER_START);
+    CHECK(app_regs.TriggerPin == 1u << TRIGGER_IO);
+
+    // core1 triggers from the GPIO pin behind the IO pin.
+    update_commands();
+    CHECK(trigger_config.mode == TRIGGER_START);
+    CHECK(trigger_config.pin == IO_PIN(TRIGGER_IO));
+}
+
+void test_disconnect_stops_schedule()
+{
+    reset_app_fixture();
+    CHECK(write_reg(LaserTaskTable, table_page(3)) == WRITE);
+    CHECK(write_reg(EnableTaskSchedule, uint8_t(1)) == WRITE);
+    update_commands();
+    CHECK(enabled);
+    // The safety stop needs no room in the command queue.
+    {
+        sim::Core0Scope core0;
+        while (send_core1_command(Core1Command::acquisition_frame_count(0))) {}
+        sim::set_op_mode(STANDBY);
+        update_app();
+    }
+    sim::set_op_mode(ACTIVE);
+    CHECK(app_regs.EnableTaskSchedule == 0);
+    CHECK(hal_doorbell_rung());
+    CHECK(update_abort_state());
+    CHECK(!enabled);
+    update_commands();
+    CHECK(!enabled);
+    // The host can start the schedule again once it reconnects.
+    CHECK(write_reg(EnableTaskSchedule, uint8_t(1)) == WRITE);
+    update_commands();
+    CHECK(enabled);
+}
+
+int main()
+{
+    test_laser_task_table_writes();
+    test_task_table_edits();
+    test_trigger_pin_checks();
+    test_disconnect_stops_schedule();
+    if (failures)
+        printf("%d check(s) failed.\r\n", failures);
+    else
+        printf("All checks passed.\r\n");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,1514 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <fip_host_fixture.h>
+#include <pio_edge_model.h>
+#include <rising_edge_event_batch.h>
+
+inline constexpr double cycles_to_us(uint64_t cycles)
+{return double(cycles) / sim::CYCLES_PER_US;}
+
+LaserPWMTiming pwm_timing(const LaserFIPTaskSettings& settings)
+{
+    return LaserPWMTiming::from_config(settings.pwm_pin_bit,
+        LaserPWMConfig::resolve(settings.pwm_duty_cycle, settings.pwm_frequency_hz,
+                                SYS_CLK_HZ));
+}
+
+std::vector<LaserFIPTaskSettings> default_fip_tasks()
+{
+    return {make_task_settings(LASER_470, CAM_G, DELTA1, DELTA2, DELTA3, DELTA4),
+            make_task_settings(LASER_415, CAM_G, DELTA1, DELTA2, DELTA3, DELTA4),
+            make_task_settings(LASER_565, CAM_R, DELTA1, DELTA2, DELTA3, DELTA4)};
+}
+
+void test_single_exposure_edges()
+{
+    reset_fixture();
+    load_tasks({make_task_settings(LASER_470, CAM_G, 1000, 200, 300, 40)});
+    uint64_t start = sim::now_cycles();
+    run_sequence();
+    uint64_t end = sim::now_cycles();
+
+    uint64_t laser_on = sim::next_edge(IO_PIN(LASER_470), true);
+    uint64_t cam_on = sim::next_edge(IO_PIN(CAM_G), true);
+    uint64_t cam_off = sim::next_edge(IO_PIN(CAM_G), false);
+    uint64_t laser_off = sim::next_edge(IO_PIN(LASER_470), false);
+    CHECK(laser_on < cam_on && cam_on < cam_off && cam_off < laser_off);
+    // Edges are anchored to the frame start, so each interval is within a
+    // timer tick of its delta.
+    CHECK(std::abs(cycles_to_us(cam_on - laser_on) - 300) < 1);
+    CHECK(std::abs(cycles_to_us(cam_off - cam_on) - 1000) < 1);
+    CHECK(std::abs(cycles_to_us(laser_off - cam_off) - 40) < 1);
+    CHECK(cycles_to_us(end - start) > 1539);
+}
+
+void test_sequence_runs_tasks_in_order()
+{
+    reset_fixture();
+    load_tasks(default_fip_tasks());
+    run_sequence();
+    uint64_t rise_470 = sim::next_edge(IO_PIN(LASER_470), true);
+    uint64_t rise_415 = sim::next_edge(IO_PIN(LASER_415), true);
+    uint64_t rise_565 = sim::next_edge(IO_PIN(LASER_565), true);
+    CHECK(rise_470 < rise_415 && rise_415 < rise_565);
+    // Cameras fire once per task that targets them.
+    CHECK(sim::rising_edges(IO_PIN(CAM_G)).size() == 2);
+    CHECK(sim::rising_edges(IO_PIN(CAM_R)).size() == 1);
+    // Lasers never overlap.
+    for (auto& sample: sim::trace())
+        CHECK(std::popcount(sample.pwm_state) <= 1);
+}
+
+void test_events_match_edges()
+{
+    reset_fixture();
+    load_tasks({make_task_settings(LASER_470, CAM_G, 1000, 200, 300, 40)});
+    run_sequence();
+    auto events = drain_events();
+    CHECK(events.size() == 2);
+    if (events.size() != 2)
+        return;
+    uint32_t laser_bit = 1u << IO_PIN(LASER_470);
+    uint32_t cam_bit = 1u << IO_PIN(CAM_G);
+    CHECK(events[0].output_state == laser_bit);
+    CHECK(events[1].output_state == (laser_bit | cam_bit));
+    // Timestamps are taken right after the edge.
+    uint64_t laser_on_us = sim::next_edge(IO_PIN(LASER_470), true) / sim::CYCLES_PER_US;
+    uint64_t cam_on_us = sim::next_edge(IO_PIN(CAM_G), true) / sim::CYCLES_PER_US;
+    CHECK(events[0].time_us - laser_on_us <= 1);
+    CHECK(events[1].time_us - cam_on_us <= 1);
+}
+
+void test_mute_keeps_timing_but_not_outputs()
+{
+    reset_fixture();
+    auto settings = make_task_settings(LASER_470, CAM_G, 1000, 200, 300, 40);
+    settings.mute = 1;
+    load_tasks({settings});
+    run_sequence();
+    CHECK(sim::rising_edges(IO_PIN(CAM_G)).empty());
+    CHECK(sim::rising_edges(IO_PIN(LASER_470)).size() == 1);
+}
+
+void test_commands_control_state()
+{
+    reset_fixture();
+    publish_tasks(default_fip_tasks());
+    {
+        sim::Core0Scope core0;
+        send_core1_command(Core1Command::enable(true));
+    }
+    CHECK(!core1_commands_applied());
+    CHECK(core1_pending_command_count() == 1);
+    update_commands();
+    CHECK(core1_commands_applied());
+    CHECK(enabled);
+    CHECK(active_schedule_backend == CPU_BACKEND);
+    run_sequence();
+    CHECK(frame_count == 1);
+
+    // Commands apply in the order they were sent, so a disable, settings and
+    // an enable in one batch restart the schedule with the new settings.
+    {
+        sim::Core0Scope core0;
+        send_core1_command(Core1Command::enable(false));
+        send_core1_command(Core1Command::backend(PIO_BACKEND));
+        send_core1_command(Core1Command::acquisition_frame_count(2));
+        send_core1_command(Core1Command::enable(true));
+    }
+    update_commands();
+    CHECK(core1_command_ack == core1_command_sequence);
+    CHECK(enabled);
+    CHECK(active_schedule_backend == PIO_BACKEND);
+    CHECK(frame_count == 0);
+    for (size_t i = 0; enabled && (i < 100); ++i)
+        run_sequence();
+    CHECK(frame_count == 2);
+    CHECK(!enabled);
+    drain_events();
+
+    // The same commands in another order end disabled.
+    {
+        sim::Core0Scope core0;
+        send_core1_command(Core1Command::acquisition_frame_count(0));
+        send_core1_command(Core1Command::enable(true));
+        send_core1_command(Core1Command::enable(false));
+    }
+    update_commands();
+    CHECK(!enabled);
+    CHECK(sim::trace().back().state() == 0);
+
+    // An enable sent after an abort survives the abort's doorbell, even if
+    // core1 applies both before it notices the doorbell.
+    {
+        sim::Core0Scope core0;
+        send_core1_abort();
+        send_core1_command(Core1Command::enable(true));
+    }
+    update_commands();
+    CHECK(!update_abort_state());
+    CHECK(enabled);
+
+    // The abort doesn't need room in the queue, and the enables that filled
+    // it before the abort don't restart the schedule, even if core1 applies
+    // them before it notices the doorbell.
+    {
+        sim::Core0Scope core0;
+        while (send_core1_command(Core1Command::enable(true))) {}
+        CHECK(core1_pending_command_count() == CORE1_COMMAND_QUEUE_SIZE);
+        send_core1_abort();
+    }
+    CHECK(hal_doorbell_rung());
+    update_commands();
+    CHECK(core1_commands_applied());
+    CHECK(enabled);
+    CHECK(update_abort_state());
+    CHECK(!enabled);
+    {
+        sim::Core0Scope core0;
+        while (send_core1_command(Core1Command::enable(true))) {}
+        send_core1_abort();
+    }
+    CHECK(update_abort_state());
+    update_commands();
+    CHECK(!enabled);
+    CHECK(!hal_doorbell_rung());
+    // An enable sent after the abort runs as usual.
+    {
+        sim::Core0Scope core0;
+        send_core1_command(Core1Command::enable(true));
+    }
+    update_commands();
+    CHECK(enabled);
+    stop_sequence();
+    drain_events();
+}
+
+void test_remove_and_clear_tasks()
+{
+    reset_fixture();
+    TaskTable table = make_task_table(default_fip_tasks());
+    publish_table(table);
+    apply_task_table(0);
+    CHECK(fip_task_count == 3);
+    // The other tasks keep their slots, so none of them is rebuilt.
+    size_t pwm_configure_count = sim::pwm_configure_count();
+    remove_task_slot(table, 0);
+    publish_table(table);
+    apply_task_table(0);
+    CHECK(fip_task_count == 2);
+    CHECK(!fip_tasks[0]);
+    CHECK(fip_tasks[fip_task_order[0]]->pwm_pin() == IO_PIN(LASER_415));
+    CHECK(sim::pwm_configure_count() == pwm_configure_count);
+    publish_tasks({});
+    apply_task_table(0);
+    CHECK(fip_task_count == 0);
+    CHECK(!fip_tasks[1] && !fip_tasks[2]);
+}
+
+void test_stable_task_slots()
+{
+    auto tasks = default_fip_tasks();
+    TaskTable table = make_task_table(tasks);
+    remove_task_slot(table, 1);
+    CHECK(table.task_count == 2);
+    CHECK(table.order[0] == 0 && table.order[1] == 2);
+    CHECK(!table.slot_used[1]);
+    CHECK(!memcmp(&table.tasks[2], &tasks[2], sizeof(tasks[2])));
+    // A new task takes the lowest free slot, but runs after the others.
+    size_t slot = add_task_slot(table);
+    CHECK(slot == 1);
+    table.tasks[slot] = tasks[1];
+    table.pwm[slot] = table.pwm[0];
+    CHECK(table.order[2] == 1);
+    CHECK(check_schedule(table) == SCHEDULE_OK);
+    reset_fixture();
+    publish_table(table);
+    apply_task_table(0);
+    CHECK(fip_timeline[0].pwm_enable_mask == tasks[0].pwm_pin_bit);
+    CHECK(fip_timeline[EDGES_PER_TASK].pwm_enable_mask == tasks[2].pwm_pin_bit);
+    CHECK(fip_timeline[2 * EDGES_PER_TASK].pwm_enable_mask == tasks[1].pwm_pin_bit);
+    // Every slot taken.
+    for (size_t index = table.task_count; index < MAX_TASK_COUNT; ++index)
+        CHECK(add_task_slot(table) == index);
+    CHECK(add_task_slot(table) == NO_TASK_SLOT);
+    clear_task_slots(table);
+    CHECK(table.task_count == 0);
+    CHECK(std::none_of(table.slot_used, table.slot_used + MAX_TASK_COUNT,
+                       [](bool used){return used;}));
+    CHECK(add_task_slot(table) == 0);
+}
+
+void test_timeline_flattens_tasks()
+{
+    FIPTimeline timeline;
+    auto first = make_task_settings(LASER_470, CAM_G, 1000, 200, 300, 40);
+    auto second = make_task_settings(LASER_565, CAM_R, 500, 100, 50, 10);
+    second.mute = 1;
+    CHECK(timeline.append_task(first));
+    CHECK(timeline.append_task(second));
+    CHECK(timeline.edge_count() == 2 * EDGES_PER_TASK);
+    CHECK(timeline.period_us() == 1540 + 660);
+    uint32_t expected_offsets[] = {0, 300, 1300, 1340, 1540, 1590, 2090, 2100};
+    for (size_t index = 0; index < timeline.edge_count(); ++index)
+        CHECK(timeline[index].offset_us == expected_offsets[index]);
+    uint32_t laser = 1u << IO_PIN(LASER_470);
+    uint32_t cam = 1u << IO_PIN(CAM_G);
+    CHECK(timeline[0].pwm_enable_mask == laser && timeline[0].event);
+    CHECK(timeline[1].set_mask == cam && timeline[1].event_state == (laser | cam));
+    CHECK(timeline[2].clear_mask == cam && !timeline[2].event);
+    CHECK(timeline[3].pwm_enable_mask == 0);
+    // Muted tasks never raise their outputs.
+    CHECK(timeline[5].set_mask == 0);
+    // The table is bounded by every task in every frame of the longest cycle.
+    timeline.clear();
+    for (size_t index = 0; index < MAX_TASK_COUNT * MAX_CYCLE_FRAME_COUNT; ++index)
+        CHECK(timeline.append_task(first));
+    CHECK(!timeline.append_task(first));
+}
+
+void test_frames_do_not_drift()
+{
+    reset_fixture();
+    // Make every event timestamp expensive so that relative sleeps would drift.
+    sim::costs().timer_read = 1000;
+    auto tasks = default_fip_tasks();
+    load_tasks(tasks);
+    uint32_t frame_period_us = fip_timeline.period_us();
+    constexpr size_t FRAMES = 2000; // ~100 seconds.
+    for (size_t frame = 0; frame < FRAMES; ++frame)
+    {
+        run_sequence();
+        drain_events();
+    }
+    CHECK(frame_count == FRAMES);
+    uint32_t session_start_us = edge_telemetry.session_start_us;
+    CHECK(frame_start_us - session_start_us == FRAMES * frame_period_us);
+    // Every frame starts within one timer tick of its nominal start (plus the
+    // sub-tick phase of the session start).
+    auto rises = sim::rising_edges(IO_PIN(LASER_470));
+    CHECK(rises.size() == FRAMES);
+    for (size_t frame = 0; frame < rises.size(); ++frame)
+    {
+        uint64_t nominal_us = session_start_us + uint64_t(frame) * frame_period_us;
+        CHECK(cycles_to_us(rises[frame]) >= double(nominal_us));
+        CHECK(cycles_to_us(rises[frame]) - double(nominal_us) < 2.0);
+    }
+    CHECK(cycles_to_us(sim::now_cycles())
+          - double(session_start_us + uint64_t(FRAMES) * frame_period_us) < 2.0);
+}
+
+void test_edge_telemetry()
+{
+    reset_fixture();
+    load_tasks(default_fip_tasks());
+    for (size_t frame = 0; frame < 10; ++frame)
+        run_sequence();
+    EdgeTelemetry telemetry;
+    edge_telemetry_snapshot.read(telemetry);
+    CHECK(telemetry.edge_count == 10 * 3 * EDGES_PER_TASK);
+    CHECK(telemetry.deadline_miss_count == 0);
+    CHECK(telemetry.max_lateness_us <= EDGE_DEADLINE_TOLERANCE_US);
+
+    // An expensive laser-on switch makes a camera edge 2us later miss.
+    reset_fixture();
+    sim::costs().pwm_mux = 8 * sim::CYCLES_PER_US;
+    load_tasks({make_task_settings(LASER_470, CAM_G, 1000, 200, 2, 40)});
+    for (size_t frame = 0; frame < 10; ++frame)
+    {
+        run_sequence();
+        drain_events();
+    }
+    edge_telemetry_snapshot.read(telemetry);
+    CHECK(telemetry.edge_count == 10 * EDGES_PER_TASK);
+    CHECK(telemetry.deadline_miss_count == 10);
+    CHECK(telemetry.min_lateness_us == 0);
+    CHECK(telemetry.max_lateness_us >= 6 && telemetry.max_lateness_us <= 7);
+    CHECK(telemetry.histogram[0] == 30);
+    CHECK(telemetry.histogram[3] == 10); // 4-7us.
+    CHECK(telemetry.mean_lateness_ns() > 0);
+    // Enabling the schedule again starts a fresh session.
+    start_sequence();
+    edge_telemetry_snapshot.read(telemetry);
+    CHECK(telemetry.edge_count == 0);
+}
+
+void test_pio_edge_table_timing()
+{
+    // 10kHz 50% PWM: the laser toggles every 6250 cycles while enabled.
+    auto settings = make_task_settings(LASER_470, CAM_G, 1000, 200, 300, 40);
+    settings.pwm_duty_cycle = 0.5f;
+    FIPTimeline timeline;
+    CHECK(timeline.append_task(settings));
+    LaserPWMTiming pwm = pwm_timing(settings);
+    CHECK(pwm.period_cycles == 12500 && pwm.high_cycles == 6250);
+    static PIOEdgeTable table;
+    CHECK(table.encode(timeline, &pwm, 1, sim::CYCLES_PER_US));
+    uint32_t frame_cycles = timeline.period_us() * sim::CYCLES_PER_US;
+    CHECK(table.frame_cycles() == frame_cycles);
+    CHECK(table.pin_mask() == ((1u << IO_PIN(LASER_470)) | (1u << IO_PIN(CAM_G))));
+
+    // Two frames through the PIO program model.
+    auto outputs = sim::run_pio_edge_program(table.words(), table.word_count(),
+                                             0, 2 * uint64_t(frame_cycles));
+    auto edges = [&](uint32_t pin, bool level)
+    {
+        std::vector<uint64_t> cycles;
+        uint32_t prev_state = 0;
+        for (auto& output: outputs)
+        {
+            bool was_set = (prev_state >> pin) & 1u;
+            bool is_set = (output.gpio_state >> pin) & 1u;
+            if ((was_set != is_set) && (is_set == level))
+                cycles.push_back(output.cycle);
+            prev_state = output.gpio_state;
+        }
+        return cycles;
+    };
+    auto laser_rises = edges(IO_PIN(LASER_470), true);
+    auto laser_falls = edges(IO_PIN(LASER_470), false);
+    auto cam_rises = edges(IO_PIN(CAM_G), true);
+    auto cam_falls = edges(IO_PIN(CAM_G), false);
+    // Every edge lands on its exact cycle.
+    CHECK(cam_rises.size() == 2 && cam_falls.size() == 2);
+    CHECK(cam_rises[0] == 300 * sim::CYCLES_PER_US);
+    CHECK(cam_falls[0] == 1300 * sim::CYCLES_PER_US);
+    CHECK(cam_rises[1] == frame_cycles + 300 * sim::CYCLES_PER_US);
+    // 1340us of laser-on is 13.4 PWM periods: 14 pulses per frame.
+    CHECK(laser_rises.size() == 28 && laser_falls.size() == 28);
+    CHECK(laser_rises[0] == 0 && laser_rises[14] == frame_cycles);
+    for (size_t index = 0; index < 13; ++index)
+    {
+        CHECK(laser_falls[index] - laser_rises[index] == 6250);
+        CHECK(laser_rises[index + 1] - laser_rises[index] == 12500);
+    }
+    // The last pulse is cut short by the laser-off edge.
+    CHECK(laser_falls[13] == 1340 * sim::CYCLES_PER_US);
+
+    // Holds longer than 24 bits are split without changing the frame length.
+    auto slow = make_task_settings(LASER_470, CAM_G, 1000, 200000, 300, 40);
+    timeline.clear();
+    CHECK(timeline.append_task(slow));
+    pwm = pwm_timing(slow);
+    CHECK(table.encode(timeline, &pwm, 1, sim::CYCLES_PER_US));
+    frame_cycles = table.frame_cycles();
+    outputs = sim::run_pio_edge_program(table.words(), table.word_count(),
+                                        0, 2 * uint64_t(frame_cycles));
+    laser_rises = edges(IO_PIN(LASER_470), true);
+    CHECK(laser_rises.size() == 2 && laser_rises[1] == frame_cycles);
+
+    // PWM levels shorter than the PIO's minimum hold saturate.
+    settings.pwm_duty_cycle = 0.0001f;
+    CHECK(pwm_timing(settings).high_cycles == 0);
+    settings.pwm_duty_cycle = 0.9999f;
+    pwm = pwm_timing(settings);
+    CHECK(pwm.high_cycles == pwm.period_cycles);
+}
+
+void test_pio_backend()
+{
+    reset_fixture();
+    {
+        sim::Core0Scope core0;
+        send_core1_command(Core1Command::backend(PIO_BACKEND));
+    }
+    update_commands();
+    load_tasks(default_fip_tasks());
+    CHECK(active_schedule_backend == PIO_BACKEND);
+    uint64_t session_start_cycle = uint64_t(edge_telemetry.session_start_us)
+                                   * sim::CYCLES_PER_US;
+    constexpr size_t FRAMES = 10;
+    std::vector<HostEvent> events;
+    for (size_t frame = 0; frame < FRAMES; ++frame)
+    {
+        run_sequence();
+        auto frame_events = drain_events();
+        events.insert(events.end(), frame_events.begin(), frame_events.end());
+    }
+    CHECK(frame_count == FRAMES);
+    stop_sequence();
+    // Events are stamped with the exact edge times the PIO produced.
+    CHECK(events.size() == FRAMES * 3 * 2);
+    auto rises = sim::rising_edges(IO_PIN(LASER_470));
+    CHECK(rises.size() == FRAMES);
+    if (rises.empty())
+        return;
+    // The PIO starts within a timer tick of the session start and then never
+    // drifts by a single cycle.
+    uint64_t start_cycle = rises[0];
+    CHECK(start_cycle >= session_start_cycle
+          && start_cycle - session_start_cycle < sim::CYCLES_PER_US);
+    uint32_t frame_period_us = fip_timeline.period_us();
+    for (size_t frame = 0; frame < rises.size(); ++frame)
+    {
+        uint64_t expected_cycle = start_cycle
+            + uint64_t(frame) * frame_period_us * sim::CYCLES_PER_US;
+        CHECK(rises[frame] == expected_cycle);
+        CHECK(events[frame * 6].time_us
+              == edge_telemetry.session_start_us + uint64_t(frame) * frame_period_us);
+    }
+    auto cam_rises = sim::rising_edges(IO_PIN(CAM_R));
+    CHECK(cam_rises.size() == FRAMES);
+    CHECK(cam_rises[0] == start_cycle + uint64_t(fip_timeline[9].offset_us) * sim::CYCLES_PER_US);
+    // Telemetry counts every PIO edge, all on time.
+    EdgeTelemetry telemetry;
+    edge_telemetry_snapshot.read(telemetry);
+    CHECK(telemetry.edge_count == FRAMES * fip_timeline.edge_count());
+    CHECK(telemetry.deadline_miss_count == 0);
+    CHECK(telemetry.min_lateness_us == 0 && telemetry.max_lateness_us == 0);
+    CHECK(telemetry.histogram[0] == telemetry.edge_count);
+    // Outputs are LOW once stopped.
+    CHECK(sim::trace().back().state() == 0);
+
+    // Frames the PIO can't generate fall back to the CPU backend.
+    auto fast_pwm = make_task_settings(LASER_470, CAM_G, 100000, 200, 300, 40);
+    fast_pwm.pwm_duty_cycle = 0.5f;
+    fast_pwm.pwm_frequency_hz = 100000.f;
+    load_tasks({fast_pwm});
+    CHECK(active_schedule_backend == CPU_BACKEND);
+}
+
+void test_timer_irq_backend()
+{
+    reset_fixture();
+    {
+        sim::Core0Scope core0;
+        send_core1_command(Core1Command::backend(TIMER_IRQ_BACKEND));
+    }
+    update_commands();
+    load_tasks(default_fip_tasks());
+    CHECK(active_schedule_backend == TIMER_IRQ_BACKEND);
+    constexpr size_t FRAMES = 10;
+    size_t wakeups = 0;
+    size_t event_count = 0;
+    while (frame_count < FRAMES)
+    {
+        run_sequence();
+        event_count += drain_events().size();
+        ++wakeups;
+    }
+    // Core1 wakes once per alarm, not once per frame.
+    CHECK(wakeups == FRAMES * 3 * EDGES_PER_TASK);
+    CHECK(event_count == FRAMES * 3 * 2);
+    // Every edge is written a fixed IRQ entry latency after its deadline.
+    auto rises = sim::rising_edges(IO_PIN(LASER_415));
+    CHECK(rises.size() == FRAMES);
+    uint32_t frame_period_us = fip_timeline.period_us();
+    uint32_t session_start_us = edge_telemetry.session_start_us;
+    for (size_t frame = 0; frame < rises.size(); ++frame)
+    {
+        uint64_t deadline_cycle = (session_start_us + uint64_t(frame) * frame_period_us
+                                   + fip_timeline[EDGES_PER_TASK].offset_us)
+                                  * sim::CYCLES_PER_US;
+        CHECK(rises[frame] > deadline_cycle);
+        CHECK(rises[frame] - deadline_cycle == rises[0]
+              - (session_start_us + fip_timeline[EDGES_PER_TASK].offset_us)
+                * sim::CYCLES_PER_US);
+    }
+    EdgeTelemetry telemetry;
+    edge_telemetry_snapshot.read(telemetry);
+    CHECK(telemetry.edge_count == FRAMES * 3 * EDGES_PER_TASK);
+    CHECK(telemetry.max_lateness_us <= EDGE_DEADLINE_TOLERANCE_US);
+
+    // Core1 can stop mid-exposure without finishing the frame.
+    run_sequence();
+    run_sequence();
+    CHECK(sim::trace().back().state() != 0);
+    stop_sequence();
+    CHECK(sim::trace().back().state() == 0);
+    uint64_t stop_cycle = sim::now_cycles();
+    run_sequence(); // Nothing is armed.
+    CHECK(sim::now_cycles() == stop_cycle);
+    CHECK(frame_count == FRAMES);
+}
+
+void test_spsc_ring()
+{
+    SPSCRing<uint32_t, 4> ring;
+    uint32_t item;
+    CHECK(!ring.try_pop(item));
+    // Indices wrap around the storage many times.
+    for (uint32_t index = 0; index < 10; ++index)
+    {
+        CHECK(ring.try_push(index));
+        CHECK(ring.try_pop(item) && item == index);
+    }
+    CHECK(ring.high_water_mark() == 1);
+    // A full ring drops and counts pushes instead of blocking.
+    for (uint32_t index = 0; index < 6; ++index)
+        ring.try_push(index);
+    CHECK(ring.size() == 4);
+    CHECK(ring.overflow_count() == 2);
+    CHECK(ring.high_water_mark() == 4);
+    for (uint32_t index = 0; index < 4; ++index)
+        CHECK(ring.try_pop(item) && item == index);
+    CHECK(ring.empty());
+    ring.clear_stats();
+    CHECK(ring.overflow_count() == 0 && ring.high_water_mark() == 0);
+
+    // Timestamps unwrap across the 32-bit timer rollover.
+    CHECK(unwrap_time_us(0xFFFFFFF0u, 0x100000010ull) == 0xFFFFFFF0ull);
+    CHECK(unwrap_time_us(0x10u, 0x100000020ull) == 0x100000010ull);
+
+    // core1 counts events core0 didn't drain in time.
+    reset_fixture();
+    load_tasks(default_fip_tasks());
+    for (size_t frame = 0; frame < 12; ++frame)
+        run_sequence();
+    CHECK(rising_edge_event_ring.high_water_mark() == RISING_EDGE_EVENT_RING_SIZE);
+    CHECK(rising_edge_event_ring.overflow_count() == 12 * 6 - RISING_EDGE_EVENT_RING_SIZE);
+    CHECK(drain_events().size() == RISING_EDGE_EVENT_RING_SIZE);
+}
+
+void test_event_batch()
+{
+    EventBatch batch;
+    CHECK(batch.count() == 0);
+    CHECK(batch.add(0x09, 1000));
+    CHECK(batch.add(0x11, 1300));
+    CHECK(batch.count() == 2 && batch.first_time_us() == 1000);
+    CHECK(batch.words()[0] == 2);
+    CHECK(batch.words()[1] == (0x09u << 24));
+    CHECK(batch.words()[2] == ((0x11u << 24) | 300));
+    CHECK(batch.words()[3] == 0);
+    // Offsets are limited to 24 bits.
+    CHECK(!batch.add(0x01, 1000 + RISING_EDGE_EVENT_BATCH_MAX_OFFSET_US + 1));
+    CHECK(batch.count() == 2);
+    batch.clear();
+    for (size_t index = 0; index < RISING_EDGE_EVENT_BATCH_CAPACITY; ++index)
+        CHECK(batch.add(0x01, index));
+    CHECK(!batch.add(0x01, 0));
+    batch.clear();
+    CHECK(batch.count() == 0 && batch.words()[1] == 0);
+}
+
+void test_event_subscriptions()
+{
+    auto settings = make_task_settings(LASER_470, CAM_G, 1000, 200, 300, 40);
+    FIPTimeline timeline;
+    // events = 1 keeps its original meaning.
+    CHECK(timeline.append_task(settings));
+    CHECK(timeline[0].event && timeline[1].event);
+    CHECK(!timeline[2].event && !timeline[3].event);
+    // Tasks with events off cost nothing at run time.
+    settings.events = 0;
+    CHECK(timeline.append_task(settings));
+    for (size_t index = EDGES_PER_TASK; index < 2 * EDGES_PER_TASK; ++index)
+        CHECK(!timeline[index].event);
+    // Per-edge flags replace the default set.
+    settings.events = EVENTS_ENABLED | EVENT_CAMERA_OFF | EVENT_LASER_OFF;
+    CHECK(timeline.append_task(settings));
+    CHECK(!timeline[8].event && !timeline[9].event);
+    CHECK(timeline[10].event && timeline[11].event);
+
+    reset_fixture();
+    auto tasks = default_fip_tasks();
+    tasks[0].events = 0;
+    tasks[1].events = EVENT_CAMERA_ON;
+    tasks[2].events = EVENT_LASER_ON | EVENT_CAMERA_ON | EVENT_CAMERA_OFF | EVENT_LASER_OFF;
+    load_tasks(tasks);
+    run_sequence();
+    auto events = drain_events();
+    CHECK(events.size() == 5);
+    if (events.size() != 5)
+        return;
+    uint32_t laser_565 = 1u << IO_PIN(LASER_565);
+    uint32_t cam_g = 1u << IO_PIN(CAM_G);
+    uint32_t cam_r = 1u << IO_PIN(CAM_R);
+    CHECK(events[0].output_state == ((1u << IO_PIN(LASER_415)) | cam_g));
+    CHECK(events[1].output_state == laser_565);
+    CHECK(events[2].output_state == (laser_565 | cam_r));
+    CHECK(events[3].output_state == laser_565); // Camera off.
+    CHECK(events[4].output_state == 0);         // Laser off.
+}
+
+void test_hot_reconfiguration()
+{
+    for (uint8_t backend: {CPU_BACKEND, PIO_BACKEND, TIMER_IRQ_BACKEND})
+    {
+        reset_fixture();
+        {
+            sim::Core0Scope core0;
+            send_core1_command(Core1Command::backend(backend));
+        }
+        update_commands();
+        auto tasks = default_fip_tasks();
+        load_tasks(tasks);
+        CHECK(task_table_swap.applied_frame() == 0);
+        uint32_t old_period_us = fip_timeline.period_us();
+        while (frame_count < 2)
+            run_sequence();
+        // Lengthen the first exposure while the schedule runs.
+        tasks[0].delta1_us += 1000;
+        CHECK(publish_tasks(tasks));
+        // A second table can't be published until core1 takes the first.
+        CHECK(!publish_tasks(tasks));
+        while (frame_count < 5)
+            run_sequence();
+        stop_sequence();
+        // The frame in progress finished with the old table.
+        CHECK(!task_table_swap.is_pending());
+        CHECK(task_table_swap.applied_frame() == 3);
+        CHECK(fip_timeline.period_us() == old_period_us + 1000);
+        auto rises = sim::rising_edges(IO_PIN(LASER_470));
+        CHECK(rises.size() == 5);
+        if (rises.size() != 5)
+            continue;
+        // Frame starts stay anchored to the schedule across the swap.
+        auto near_us = [](uint64_t cycles, uint32_t us)
+        {return std::abs(cycles_to_us(cycles) - us) < 2;};
+        CHECK(near_us(rises[3] - rises[2], old_period_us));
+        CHECK(near_us(rises[4] - rises[3], old_period_us + 1000));
+        // Every frame still reported every event.
+        CHECK(drain_events().size() == 5 * 6);
+        // The first edge after the swap was on time.
+        EdgeTelemetry telemetry;
+        edge_telemetry_snapshot.read(telemetry);
+        CHECK(telemetry.deadline_miss_count == 0);
+        if (backend != TIMER_IRQ_BACKEND)
+            continue;
+
+        // The alarm handler leaves the swap to core1's thread context, which
+        // does it in the idle gap before the next frame.
+        load_tasks(tasks);
+        while (frame_count < 2)
+            run_sequence();
+        tasks[0].delta1_us -= 1000;
+        CHECK(publish_tasks(tasks));
+        while (frame_count < 3)
+            hal_wait_for_event();
+        CHECK(task_table_swap.is_pending());
+        uint64_t swap_cycle = sim::now_cycles();
+        while (frame_count < 4)
+            run_sequence();
+        stop_sequence();
+        CHECK(task_table_swap.applied_frame() == 3);
+        rises = sim::rising_edges(IO_PIN(LASER_470));
+        CHECK(rises.size() == 4);
+        if (rises.size() != 4)
+            continue;
+        CHECK(rises[3] > swap_cycle);
+        CHECK(near_us(rises[3] - rises[2], old_period_us + 1000));
+        edge_telemetry_snapshot.read(telemetry);
+        CHECK(telemetry.deadline_miss_count == 0);
+        drain_events();
+    }
+}
+
+void test_task_table_swap_changes_task_count()
+{
+    reset_fixture();
+    load_tasks(default_fip_tasks());
+    run_sequence();
+    // Switch experiments: a whole new table with one task fewer.
+    auto tasks = default_fip_tasks();
+    tasks.pop_back();
+    tasks[0].pwm_pin_bit = 1u << IO_PIN(LASER_565);
+    CHECK(publish_tasks(tasks));
+    run_sequence();
+    CHECK(fip_task_count == 2);
+    CHECK(task_table_swap.applied_frame() == 2);
+    drain_events();
+    run_sequence();
+    stop_sequence();
+    CHECK(fip_timeline.edge_count() == 2 * EDGES_PER_TASK);
+    auto events = drain_events();
+    CHECK(events.size() == 4);
+    if (events.size() == 4)
+        CHECK(events[0].output_state == (1u << IO_PIN(LASER_565)));
+}
+
+void test_full_task_table()
+{
+    reset_fixture();
+    // Lasers and cameras are shared once there are more tasks than IO pins.
+    std::vector<LaserFIPTaskSettings> tasks;
+    for (size_t index = 0; index < MAX_TASK_COUNT; ++index)
+        tasks.push_back(make_task_settings(index % 3, CAM_G + (index % 2),
+                                           1000, 200, 300, 40));
+    load_tasks(tasks);
+    CHECK(fip_task_count == MAX_TASK_COUNT);
+    CHECK(fip_timeline.period_us() == MAX_TASK_COUNT * 1540);
+    run_sequence();
+    stop_sequence();
+    CHECK(drain_events().size() == 2 * MAX_TASK_COUNT);
+    CHECK(sim::rising_edges(IO_PIN(CAM_G)).size() == (MAX_TASK_COUNT + 1) / 2);
+}
+
+void test_pwm_config()
+{
+    // 10kHz 50%: 12500 cycles, undivided.
+    auto pwm = LaserPWMConfig::resolve(0.5f, 10000.f, SYS_CLK_HZ);
+    CHECK(pwm.clkdiv_x16 == 16 && pwm.wrap == 12499 && pwm.level == 6250);
+    CHECK(pwm.period_cycles() == 12500 && pwm.high_cycles() == 6250);
+    // Slow PWM divides the clock just enough to fit the 16-bit counter.
+    pwm = LaserPWMConfig::resolve(0.25f, 100.f, SYS_CLK_HZ);
+    CHECK(pwm.clkdiv_x16 == 306);
+    CHECK(std::abs(double(pwm.period_cycles()) - 1250000) < 20);
+    CHECK(std::abs(4 * int(pwm.level) - (int(pwm.wrap) + 1)) <= 2);
+    // Constant levels.
+    pwm = LaserPWMConfig::resolve(1.f, 10000.f, SYS_CLK_HZ);
+    CHECK(pwm.level > pwm.wrap);
+    CHECK(LaserPWMConfig::resolve(0.f, 10000.f, SYS_CLK_HZ).level == 0);
+    // Below the slowest period, saturate.
+    pwm = LaserPWMConfig::resolve(0.5f, 0.01f, SYS_CLK_HZ);
+    CHECK(pwm.clkdiv_x16 == 0xFFF && pwm.wrap == 0xFFFF);
+
+    // core1 only writes the registers core0 resolved.
+    reset_fixture();
+    auto tasks = default_fip_tasks();
+    tasks[1].pwm_duty_cycle = 0.25f;
+    tasks[1].pwm_frequency_hz = 20000.f;
+    load_tasks(tasks);
+    auto slice = sim::pwm_config(IO_PIN(LASER_415));
+    CHECK(slice.clkdiv_x16 == 16 && slice.wrap == 6249 && slice.level == 1563);
+    CHECK(fip_tasks[1]->pwm_ == LaserPWMConfig::resolve(0.25f, 20000.f, SYS_CLK_HZ));
+}
+
+void test_reconfigure_touches_changed_hardware()
+{
+    reset_fixture();
+    auto tasks = default_fip_tasks();
+    load_tasks(tasks);
+    // Timing only: core1 updates the task, but writes no hardware.
+    size_t pwm_configure_count = sim::pwm_configure_count();
+    uint64_t start = sim::now_cycles();
+    tasks[0].delta1_us += 1000;
+    publish_tasks(tasks);
+    apply_task_table(0);
+    CHECK(sim::now_cycles() == start);
+    CHECK(sim::pwm_configure_count() == pwm_configure_count);
+    CHECK(fip_tasks[0]->settings_.delta1_us == tasks[0].delta1_us);
+    CHECK(fip_timeline[2].offset_us == DELTA3 + tasks[0].delta1_us);
+    // A new duty cycle on the same laser is one slice configuration.
+    tasks[1].pwm_duty_cycle = 0.5f;
+    publish_tasks(tasks);
+    apply_task_table(0);
+    CHECK(sim::pwm_configure_count() == pwm_configure_count + 1);
+    CHECK(sim::pwm_config(IO_PIN(LASER_415)).level == 6250);
+    // A new laser pin is set up like a new task.
+    tasks[2].pwm_pin_bit = 1u << IO_PIN(LASER_470);
+    publish_tasks(tasks);
+    apply_task_table(0);
+    CHECK(sim::pwm_configure_count() == pwm_configure_count + 2);
+    CHECK(fip_tasks[2]->pwm_pin() == IO_PIN(LASER_470));
+}
+
+void test_schedule_check()
+{
+    auto tasks = default_fip_tasks();
+    CHECK(check_schedule(make_task_table(tasks)) == SCHEDULE_OK);
+    CHECK(check_schedule(make_task_table({})) == SCHEDULE_OK);
+    uint32_t task_period_us = DELTA1 + DELTA2 + DELTA3 + DELTA4;
+    CHECK(frame_cycle_period_us(make_task_table(tasks)) == 3 * task_period_us);
+    // Each laser emits for one exposure per frame.
+    float duty = laser_duty_fraction(make_task_table(tasks),
+                                     1u << IO_PIN(LASER_470));
+    CHECK(std::abs(duty - float(DELTA3 + DELTA1 + DELTA4) / (3 * task_period_us)) < 1e-6f);
+    tasks[0].pwm_duty_cycle = 0.5f;
+    CHECK(std::abs(laser_duty_fraction(make_task_table(tasks),
+                                       1u << IO_PIN(LASER_470)) - duty / 2) < 1e-6f);
+    CHECK(laser_duty_fraction(make_task_table(tasks), 1u << IO_PIN(CAM_G)) == 0);
+    CHECK(task_output_pins(make_task_table(tasks))
+          == ((1u << IO_PIN(LASER_470)) | (1u << IO_PIN(LASER_415))
+              | (1u << IO_PIN(LASER_565)) | (1u << IO_PIN(CAM_G))
+              | (1u << IO_PIN(CAM_R))));
+    CHECK(task_output_pins(make_task_table({})) == 0);
+
+    // A laser can't also be a camera output.
+    tasks = default_fip_tasks();
+    tasks[2].output_mask |= 1u << IO_PIN(LASER_470);
+    CHECK(check_schedule(make_task_table(tasks)) == SCHEDULE_PIN_CONFLICT);
+    // Exposures of one camera can't be empty or back to back.
+    tasks = default_fip_tasks();
+    tasks[1].delta1_us = 0;
+    CHECK(check_schedule(make_task_table(tasks)) == SCHEDULE_CAMERA_OVERLAP);
+    tasks = default_fip_tasks();
+    tasks[0].delta4_us = tasks[0].delta2_us = tasks[1].delta3_us = 0;
+    CHECK(check_schedule(make_task_table(tasks)) == SCHEDULE_CAMERA_OVERLAP);
+    // ...unless the camera doesn't expose in between.
+    tasks[0].mute = 1;
+    CHECK(check_schedule(make_task_table(tasks)) == SCHEDULE_OK);
+    // Nor back to back across the frame boundary.
+    tasks = {make_task_settings(LASER_470, CAM_G, 1000, 0, 0, 0)};
+    CHECK(check_schedule(make_task_table(tasks)) == SCHEDULE_CAMERA_OVERLAP);
+    tasks[0].delta2_us = 1;
+    CHECK(check_schedule(make_task_table(tasks)) == SCHEDULE_OK);
+    // Nor overlapping, within the cycle or across its end. Tasks never place
+    // a camera's exposure before its last one ends, so walk them directly.
+    CameraExposureWalk walk;
+    CHECK(walk.append(0, 1000));
+    CHECK(!CameraExposureWalk(walk).append(999, 2000));
+    CHECK(!CameraExposureWalk(walk).append(1000, 2000));
+    CHECK(walk.append(1001, 2000));
+    CHECK(!walk.wraps(1500));
+    CHECK(!walk.wraps(2000));
+    CHECK(walk.wraps(2001));
+    // The frame period must be between 1us and MAX_FRAME_PERIOD_US.
+    tasks = {make_task_settings(LASER_470, CAM_G, 0, 0, 0, 0)};
+    tasks[0].output_mask = 0;
+    CHECK(check_schedule(make_task_table(tasks)) == SCHEDULE_EMPTY_FRAME);
+    tasks = default_fip_tasks();
+    tasks[2].delta2_us = UINT32_MAX;
+    CHECK(check_schedule(make_task_table(tasks)) == SCHEDULE_FRAME_TOO_LONG);
+    CHECK(frame_cycle_period_us(make_task_table(tasks)) == UINT32_MAX);
+}
+
+void test_fixed_frame_period()
+{
+    auto tasks = default_fip_tasks();
+    uint32_t task_period_us = DELTA1 + DELTA2 + DELTA3 + DELTA4;
+    constexpr uint32_t FRAME_PERIOD_US = 60000;
+    // Tasks must fit in the fixed period, and the period pads the camera's
+    // gap across the frame boundary.
+    CHECK(check_schedule(make_task_table(tasks, FRAME_PERIOD_US)) == SCHEDULE_OK);
+    CHECK(check_schedule(make_task_table(tasks, 3 * task_period_us - 1))
+          == SCHEDULE_FRAME_OVERRUN);
+    CHECK(check_schedule(make_task_table(tasks, MAX_FRAME_PERIOD_US + 1))
+          == SCHEDULE_FRAME_TOO_LONG);
+    CHECK(frame_cycle_period_us(make_task_table(tasks, FRAME_PERIOD_US))
+          == FRAME_PERIOD_US);
+    auto back_to_back = std::vector{make_task_settings(LASER_470, CAM_G, 1000, 0, 0, 0)};
+    CHECK(check_schedule(make_task_table(back_to_back)) == SCHEDULE_CAMERA_OVERLAP);
+    CHECK(check_schedule(make_task_table(back_to_back, 2000)) == SCHEDULE_OK);
+
+    for (uint8_t backend: {CPU_BACKEND, PIO_BACKEND, TIMER_IRQ_BACKEND})
+    {
+        reset_fixture();
+        {
+            sim::Core0Scope core0;
+            send_core1_command(Core1Command::backend(backend));
+        }
+        update_commands();
+        tasks = default_fip_tasks();
+        load_tasks(tasks, FRAME_PERIOD_US);
+        CHECK(fip_timeline.period_us() == FRAME_PERIOD_US);
+        while (frame_count < 2)
+            run_sequence();
+        // The cadence holds while a task is lengthened.
+        tasks[0].delta1_us += 1000;
+        CHECK(publish_tasks(tasks, FRAME_PERIOD_US));
+        while (frame_count < 5)
+            run_sequence();
+        stop_sequence();
+        CHECK(active_schedule_backend == backend);
+        CHECK(fip_timeline.period_us() == FRAME_PERIOD_US);
+        // The first laser turns on at every frame start.
+        auto rises = sim::rising_edges(IO_PIN(LASER_470));
+        CHECK(rises.size() == 5);
+        for (size_t i = 1; i < rises.size(); ++i)
+            CHECK(std::abs(cycles_to_us(rises[i] - rises[i - 1]) - FRAME_PERIOD_US) < 2);
+    }
+}
+
+void test_frame_divisors()
+{
+    auto tasks = default_fip_tasks();
+    TaskTable table = make_task_table(tasks);
+    // The 415nm laser every other frame, on odd frames.
+    table.frame_divisors[1] = {2, 1};
+    CHECK(check_schedule(table) == SCHEDULE_OK);
+    CHECK(frame_cycle_length(table) == 2);
+    uint32_t task_period_us = DELTA1 + DELTA2 + DELTA3 + DELTA4;
+    CHECK(frame_task_time_us(table, 0) == 2 * task_period_us);
+    CHECK(frame_task_time_us(table, 1) == 3 * task_period_us);
+    CHECK(frame_cycle_period_us(table) == 5 * task_period_us);
+    // Per cycle, the 470nm laser exposes twice and the 415nm laser once.
+    float exposure_fraction = float(DELTA3 + DELTA1 + DELTA4) / (5 * task_period_us);
+    CHECK(std::abs(laser_duty_fraction(table, 1u << IO_PIN(LASER_470))
+                   - 2 * exposure_fraction) < 1e-6f);
+    CHECK(std::abs(laser_duty_fraction(table, 1u << IO_PIN(LASER_415))
+                   - exposure_fraction) < 1e-6f);
+    // Phases must be less than their divisor, and frames must repeat within
+    // MAX_CYCLE_FRAME_COUNT.
+    table.frame_divisors[1] = {2, 2};
+    CHECK(check_schedule(table) == SCHEDULE_BAD_FRAME_DIVISOR);
+    table.frame_divisors[1] = {3, 0};
+    table.frame_divisors[2] = {MAX_CYCLE_FRAME_COUNT, 0};
+    CHECK(check_schedule(table) == SCHEDULE_BAD_FRAME_DIVISOR);
+    // Every frame must run something, unless it is padded.
+    table = make_task_table({tasks[0]});
+    table.frame_divisors[0] = {2, 0};
+    CHECK(check_schedule(table) == SCHEDULE_EMPTY_FRAME);
+    table.fixed_frame_period_us = 20000;
+    CHECK(check_schedule(table) == SCHEDULE_OK);
+
+    for (uint8_t backend: {CPU_BACKEND, PIO_BACKEND, TIMER_IRQ_BACKEND})
+    {
+        reset_fixture();
+        {
+            sim::Core0Scope core0;
+            send_core1_command(Core1Command::backend(backend));
+        }
+        update_commands();
+        load_tasks(tasks);
+        while (frame_count < 2)
+            run_sequence();
+        // From frame 3 on, run the 415nm laser on even frames only. The
+        // phase counts from frame 0, not from when the table was swapped in.
+        table = make_task_table(tasks);
+        table.frame_divisors[1] = {2, 0};
+        CHECK(publish_table(table));
+        while (frame_count < 7)
+            run_sequence();
+        stop_sequence();
+        CHECK(active_schedule_backend == backend);
+        CHECK(task_table_swap.applied_frame() == 3);
+        CHECK(frame_count == 7);
+        auto rises_470 = sim::rising_edges(IO_PIN(LASER_470));
+        auto rises_415 = sim::rising_edges(IO_PIN(LASER_415));
+        // 415nm runs in frames 0, 1, 2, 4 and 6.
+        CHECK(rises_470.size() == 7);
+        CHECK(rises_415.size() == 5);
+        if ((rises_470.size() != 7) || (rises_415.size() != 5))
+            continue;
+        // Frames without the 415nm task are one task shorter.
+        auto frame_us = [&](size_t frame)
+        {return cycles_to_us(rises_470[frame + 1] - rises_470[frame]);};
+        CHECK(std::abs(frame_us(3) - 2 * task_period_us) < 2);
+        CHECK(std::abs(frame_us(4) - 3 * task_period_us) < 2);
+        CHECK(std::abs(frame_us(5) - 2 * task_period_us) < 2);
+        CHECK(rises_415[3] > rises_470[4] && rises_415[3] < rises_470[5]);
+        CHECK(rises_415[4] > rises_470[6]);
+        CHECK(drain_events().size() == (7 + 5 + 7) * 2);
+    }
+}
+
+void test_pipelined_exposures()
+{
+    auto tasks = default_fip_tasks();
+    TaskTable table = make_task_table(tasks);
+    table.pipelined_exposures = true;
+    CHECK(check_schedule(table) == SCHEDULE_OK);
+    // The 415nm task shares CAM_G with the 470nm task, so it waits for it to
+    // end. The 565nm laser turns on as soon as CAM_G stops exposing, while
+    // the 415nm laser is still on, and CAM_R starts once it is off.
+    uint32_t task_period_us = DELTA1 + DELTA2 + DELTA3 + DELTA4;
+    uint32_t frame_period_us = 2 * task_period_us + DELTA3 + DELTA1;
+    CHECK(frame_task_time_us(table, 0) == frame_period_us);
+    CHECK(frame_cycle_period_us(table) == frame_period_us);
+    CHECK(frame_period_us < 3 * task_period_us);
+
+    // The overlapping edges are merged in by time.
+    FIPTimeline timeline;
+    timeline.set_pipelined(true);
+    for (auto& settings: tasks)
+        CHECK(timeline.append_task(settings));
+    CHECK(timeline.end_frame(0));
+    CHECK(timeline.period_us() == frame_period_us);
+    CHECK(timeline.edge_count() == 3 * EDGES_PER_TASK);
+    uint32_t lasers_415_565 = tasks[1].pwm_pin_bit | tasks[2].pwm_pin_bit;
+    bool lasers_overlap = false;
+    for (size_t index = 1; index < timeline.edge_count(); ++index)
+    {
+        CHECK(timeline[index].offset_us >= timeline[index - 1].offset_us);
+        lasers_overlap |= (timeline[index].pwm_enable_mask == lasers_415_565);
+    }
+    CHECK(lasers_overlap);
+    CHECK(timeline[timeline.edge_count() - 1].pwm_enable_mask == 0);
+
+    uint32_t laser_pins = 0;
+    uint32_t camera_pins = 0;
+    for (auto& settings: tasks)
+    {
+        laser_pins |= settings.pwm_pin_bit;
+        camera_pins |= settings.output_mask;
+    }
+    constexpr uint32_t FRAMES = 5;
+    for (uint8_t backend: {CPU_BACKEND, PIO_BACKEND, TIMER_IRQ_BACKEND})
+    {
+        reset_fixture();
+        {
+            sim::Core0Scope core0;
+            send_core1_command(Core1Command::backend(backend));
+        }
+        update_commands();
+        load_table(table);
+        while (frame_count < FRAMES)
+            run_sequence();
+        stop_sequence();
+        CHECK(active_schedule_backend == backend);
+        // Whenever a camera exposes, it is the only one, and exactly one
+        // laser is on.
+        const auto& trace = sim::trace();
+        for (size_t index = 0; index + 1 < trace.size(); ++index)
+        {
+            if (trace[index + 1].cycle == trace[index].cycle)
+                continue;
+            uint32_t state = trace[index].state();
+            if (!(state & camera_pins))
+                continue;
+            CHECK(std::popcount(state & camera_pins) == 1);
+            CHECK(std::popcount(state & laser_pins) == 1);
+        }
+        auto rises_470 = sim::rising_edges(IO_PIN(LASER_470));
+        CHECK(rises_470.size() == FRAMES);
+        for (size_t frame = 0; frame + 1 < rises_470.size(); ++frame)
+        {
+            CHECK(std::abs(cycles_to_us(rises_470[frame + 1] - rises_470[frame])
+                           - frame_period_us) < 2);
+        }
+        CHECK(sim::rising_edges(IO_PIN(CAM_G)).size() == 2 * FRAMES);
+        CHECK(sim::rising_edges(IO_PIN(CAM_R)).size() == FRAMES);
+        CHECK(drain_events().size() == 3 * 2 * FRAMES);
+    }
+}
+
+void test_finite_acquisition()
+{
+    auto tasks = default_fip_tasks();
+    TaskTable table = make_task_table(tasks);
+    // Two-frame cycles, so that 5 frames end partway through a cycle.
+    table.frame_divisors[1] = {2, 1};
+    uint32_t task_period_us = DELTA1 + DELTA2 + DELTA3 + DELTA4;
+    constexpr uint32_t FRAMES = 5;
+    for (uint8_t backend: {CPU_BACKEND, PIO_BACKEND, TIMER_IRQ_BACKEND})
+    {
+        reset_fixture();
+        {
+            sim::Core0Scope core0;
+            send_core1_command(Core1Command::backend(backend));
+            send_core1_command(Core1Command::acquisition_frame_count(FRAMES));
+        }
+        update_commands();
+        for (size_t run = 0; run < 2; ++run)
+        {
+            load_table(table);
+            enabled = true;
+            for (size_t i = 0; enabled && (i < 1000); ++i)
+                run_sequence();
+            CHECK(!enabled);
+            CHECK(active_schedule_backend == backend);
+            CHECK(frame_count == FRAMES);
+            CHECK(sim::rising_edges(IO_PIN(LASER_470)).size() == FRAMES);
+            CHECK(sim::rising_edges(IO_PIN(LASER_415)).size() == FRAMES / 2);
+            CHECK(sim::trace().back().state() == 0);
+            CHECK(drain_events().size() == (2 * FRAMES + FRAMES / 2) * 2);
+            // Frames 0, 2 and 4 run two tasks, frames 1 and 3 run three.
+            AcquisitionEndData end_data{};
+            CHECK(acquisition_end_ring.try_pop(end_data));
+            CHECK(end_data.frame_count == FRAMES);
+            CHECK(end_data.time_us == edge_telemetry.session_start_us + 12 * task_period_us);
+            CHECK(sim::now_cycles() / sim::CYCLES_PER_US >= end_data.time_us);
+            CHECK(!acquisition_end_ring.try_pop(end_data));
+        }
+
+        // The end carries the last enable applied while the acquisition ran,
+        // including one sent while it was already running, so that core0
+        // can tell it from the end of an earlier acquisition.
+        {
+            sim::Core0Scope core0;
+            send_core1_command(Core1Command::enable(true));
+        }
+        update_commands();
+        run_sequence();
+        {
+            sim::Core0Scope core0;
+            send_core1_command(Core1Command::enable(true));
+        }
+        update_commands();
+        CHECK(enabled);
+        CHECK(frame_count < FRAMES);
+        for (size_t i = 0; enabled && (i < 1000); ++i)
+            run_sequence();
+        CHECK(frame_count == FRAMES);
+        AcquisitionEndData end_data{};
+        CHECK(acquisition_end_ring.try_pop(end_data));
+        CHECK(end_data.enable_sequence == core1_command_sequence);
+        drain_events();
+    }
+}
+
+void test_scheduled_start()
+{
+    for (uint8_t backend: {CPU_BACKEND, PIO_BACKEND, TIMER_IRQ_BACKEND})
+    {
+        reset_fixture();
+        {
+            sim::Core0Scope core0;
+            send_core1_command(Core1Command::backend(backend));
+        }
+        update_commands();
+        publish_tasks(default_fip_tasks());
+        apply_task_table(0);
+        sim::clear_trace();
+        // The first frame starts on the scheduled tick.
+        uint32_t start_us = hal_time_us_32() + 5000;
+        start_sequence_at(start_us);
+        while (frame_count < 2)
+            run_sequence();
+        stop_sequence();
+        CHECK(active_schedule_backend == backend);
+        CHECK(edge_telemetry.session_start_us == start_us);
+        auto rises_470 = sim::rising_edges(IO_PIN(LASER_470));
+        CHECK(rises_470.size() == 2);
+        if (rises_470.empty())
+            continue;
+        CHECK(rises_470[0] >= uint64_t(start_us) * sim::CYCLES_PER_US);
+        CHECK(cycles_to_us(rises_470[0]) - start_us < 1);
+        drain_events();
+
+        // A start time that has passed starts right away.
+        uint32_t now_us = hal_time_us_32();
+        start_sequence_at(now_us - 1000);
+        stop_sequence();
+        CHECK(int32_t(edge_telemetry.session_start_us - now_us) >= 0);
+        CHECK(edge_telemetry.session_start_us - now_us <= 3);
+
+        // core1 keeps applying commands during the lead time of a start sent
+        // as a command, so a disable cancels it before any output rises.
+        reset_fixture();
+        {
+            sim::Core0Scope core0;
+            send_core1_command(Core1Command::backend(backend));
+        }
+        update_commands();
+        publish_tasks(default_fip_tasks());
+        sim::clear_trace();
+        start_us = hal_time_us_32() + 50'000;
+        {
+            sim::Core0Scope core0;
+            send_core1_command(Core1Command::start_at(start_us));
+        }
+        uint64_t cancel_cycle = uint64_t(start_us - 20'000) * sim::CYCLES_PER_US;
+        sim::schedule_core0(cancel_cycle, []
+        {
+            send_core1_command(Core1Command::enable(false));
+        });
+        run_once();
+        CHECK(enabled);
+        for (size_t i = 0; enabled && (i < 1000); ++i)
+            run_once();
+        CHECK(!enabled);
+        CHECK(sim::now_cycles() - cancel_cycle
+              <= (SCHEDULED_START_POLL_US + 2) * sim::CYCLES_PER_US);
+        hal_busy_wait_until_us_32(start_us + 100'000);
+        run_once();
+        CHECK(!enabled);
+        CHECK(core1_commands_applied());
+        CHECK(sim::trace().empty());
+
+        // Left alone, it starts on the scheduled tick.
+        start_us = hal_time_us_32() + 50'000;
+        {
+            sim::Core0Scope core0;
+            send_core1_command(Core1Command::start_at(start_us));
+        }
+        for (size_t i = 0; (frame_count < 1) && (i < 1000); ++i)
+            run_once();
+        stop_sequence();
+        CHECK(active_schedule_backend == backend);
+        CHECK(edge_telemetry.session_start_us == start_us);
+        rises_470 = sim::rising_edges(IO_PIN(LASER_470));
+        CHECK(rises_470.size() == 1);
+        if (rises_470.empty())
+            continue;
+        CHECK(cycles_to_us(rises_470[0]) - start_us < 1);
+        drain_events();
+    }
+}
+
+void test_external_trigger()
+{
+    constexpr uint32_t TRIGGER_IO = 7;
+    uint32_t task_period_us = DELTA1 + DELTA2 + DELTA3 + DELTA4;
+    for (uint8_t backend: {CPU_BACKEND, PIO_BACKEND, TIMER_IRQ_BACKEND})
+    {
+        // TRIGGER_START: the first frame waits for the edge, and the rest
+        // follow back to back.
+        reset_fixture();
+        {
+            sim::Core0Scope core0;
+            send_core1_command(Core1Command::backend(backend));
+            send_core1_command(Core1Command::trigger({TRIGGER_START, IO_PIN(TRIGGER_IO)}));
+        }
+        update_commands();
+        publish_tasks(default_fip_tasks());
+        apply_task_table(0);
+        sim::clear_trace();
+        start_sequence();
+        for (size_t i = 0; i < 10; ++i)
+            run_sequence();
+        CHECK(frame_count == 0);
+        CHECK(sim::trace().empty());
+        uint64_t trigger_cycle = sim::now_cycles() + 1000 * sim::CYCLES_PER_US;
+        sim::schedule_trigger(trigger_cycle);
+        for (size_t i = 0; (frame_count < 3) && (i < 1000); ++i)
+            run_sequence();
+        stop_sequence();
+        CHECK(active_schedule_backend == backend);
+        auto rises_470 = sim::rising_edges(IO_PIN(LASER_470));
+        CHECK(rises_470.size() == 3);
+        if (rises_470.size() != 3)
+            continue;
+        double trigger_us = double(trigger_cycle) / sim::CYCLES_PER_US;
+        CHECK(std::abs(cycles_to_us(rises_470[0]) - trigger_us
+                       - TRIGGER_START_DELAY_US) < 2);
+        CHECK(std::abs(int32_t(trigger_latency_us) - int32_t(TRIGGER_START_DELAY_US)) <= 1);
+        CHECK(std::abs(cycles_to_us(rises_470[1] - rises_470[0])
+                       - 3 * task_period_us) < 2);
+        drain_events();
+
+        // TRIGGER_EACH_FRAME: every frame waits for its own edge, and edges
+        // during a frame are ignored. The 415nm task still runs every other
+        // frame.
+        reset_fixture();
+        {
+            sim::Core0Scope core0;
+            send_core1_command(Core1Command::backend(backend));
+            send_core1_command(Core1Command::trigger({TRIGGER_EACH_FRAME, IO_PIN(TRIGGER_IO)}));
+        }
+        update_commands();
+        TaskTable table = make_task_table(default_fip_tasks());
+        table.frame_divisors[1] = {2, 1};
+        CHECK(publish_table(table));
+        apply_task_table(0);
+        sim::clear_trace();
+        start_sequence();
+        uint64_t first_cycle = sim::now_cycles() + 1000 * sim::CYCLES_PER_US;
+        const uint64_t trigger_cycles[] =
+        {
+            first_cycle,
+            first_cycle + 20'000 * sim::CYCLES_PER_US, // during frame 0.
+            first_cycle + 100'000 * sim::CYCLES_PER_US,
+            first_cycle + 200'000 * sim::CYCLES_PER_US,
+        };
+        for (uint64_t cycle: trigger_cycles)
+            sim::schedule_trigger(cycle);
+        for (size_t i = 0; (sim::now_cycles() < first_cycle + 300'000 * sim::CYCLES_PER_US)
+                           && (i < 1000); ++i)
+            run_sequence();
+        stop_sequence();
+        CHECK(active_schedule_backend == backend);
+        CHECK(frame_count == 3);
+        rises_470 = sim::rising_edges(IO_PIN(LASER_470));
+        auto rises_415 = sim::rising_edges(IO_PIN(LASER_415));
+        CHECK(rises_470.size() == 3);
+        CHECK(rises_415.size() == 1);
+        if ((rises_470.size() != 3) || (rises_415.size() != 1))
+            continue;
+        const size_t frame_triggers[] = {0, 2, 3};
+        for (size_t frame = 0; frame < 3; ++frame)
+        {
+            trigger_us = double(trigger_cycles[frame_triggers[frame]]) / sim::CYCLES_PER_US;
+            CHECK(std::abs(cycles_to_us(rises_470[frame]) - trigger_us
+                           - TRIGGER_START_DELAY_US) < 2);
+        }
+        CHECK(rises_415[0] > rises_470[1] && rises_415[0] < rises_470[2]);
+        CHECK(max_trigger_latency_us <= TRIGGER_START_DELAY_US + 1);
+        CHECK(drain_events().size() == (3 + 1 + 3) * 2);
+    }
+}
+
+void test_empty_frames()
+{
+    // One task every other frame, so odd frames only hold the padding.
+    auto tasks = default_fip_tasks();
+    tasks.resize(1);
+    TaskTable table = make_task_table(tasks);
+    table.frame_divisors[table.order[0]] = {2, 0};
+    table.fixed_frame_period_us = 20'000;
+    CHECK(has_empty_frame(table));
+    CHECK(!has_empty_frame(make_task_table(default_fip_tasks())));
+    constexpr uint32_t TRIGGER_IO = 7;
+    constexpr uint32_t FRAMES = 4;
+    for (uint8_t backend: {CPU_BACKEND, PIO_BACKEND, TIMER_IRQ_BACKEND})
+    {
+        // A finite acquisition that ends on an empty frame.
+        reset_fixture();
+        {
+            sim::Core0Scope core0;
+            send_core1_command(Core1Command::backend(backend));
+            send_core1_command(Core1Command::acquisition_frame_count(FRAMES));
+        }
+        update_commands();
+        load_table(table);
+        enabled = true;
+        for (size_t i = 0; enabled && (i < 1000); ++i)
+            run_sequence();
+        CHECK(!enabled);
+        CHECK(frame_count == FRAMES);
+        CHECK(sim::rising_edges(IO_PIN(LASER_470)).size() == FRAMES / 2);
+        AcquisitionEndData end_data{};
+        CHECK(acquisition_end_ring.try_pop(end_data));
+        CHECK(end_data.time_us == edge_telemetry.session_start_us
+                                  + FRAMES * table.fixed_frame_period_us);
+        drain_events();
+
+        // Core0 rejects TRIGGER_EACH_FRAME for such a table, but core1 must
+        // still not read past an empty timeline if it gets one.
+        reset_fixture();
+        {
+            sim::Core0Scope core0;
+            send_core1_command(Core1Command::backend(backend));
+            send_core1_command(Core1Command::trigger({TRIGGER_EACH_FRAME, IO_PIN(TRIGGER_IO)}));
+        }
+        update_commands();
+        load_table(table);
+        uint64_t first_cycle = sim::now_cycles() + 1000 * sim::CYCLES_PER_US;
+        for (size_t frame = 0; frame < FRAMES; ++frame)
+            sim::schedule_trigger(first_cycle + frame * 50'000 * sim::CYCLES_PER_US);
+        for (size_t i = 0; (sim::now_cycles() < first_cycle + 250'000 * sim::CYCLES_PER_US)
+                           && (i < 1000); ++i)
+            run_sequence();
+        stop_sequence();
+        CHECK(frame_count == FRAMES);
+        CHECK(sim::rising_edges(IO_PIN(LASER_470)).size() == FRAMES / 2);
+        drain_events();
+    }
+}
+
+void test_abort_latency()
+{
+    // Ring the doorbell with only a laser on, with a laser and camera on, in
+    // the next task, and in the idle gap between frames.
+    uint32_t task_period_us = DELTA1 + DELTA2 + DELTA3 + DELTA4;
+    const uint32_t ring_offsets_us[] =
+    {
+        DELTA3 / 2,
+        DELTA3 + DELTA1 / 2,
+        task_period_us + DELTA3 + 1234,
+        3 * task_period_us - DELTA2 / 2,
+    };
+    for (uint8_t backend: {CPU_BACKEND, PIO_BACKEND, TIMER_IRQ_BACKEND})
+    {
+        for (uint32_t ring_offset_us: ring_offsets_us)
+        {
+            reset_fixture();
+            {
+                sim::Core0Scope core0;
+                send_core1_command(Core1Command::backend(backend));
+            }
+            update_commands();
+            load_tasks(default_fip_tasks());
+            enabled = true;
+            // Ring partway through a microsecond.
+            uint64_t ring_cycle = uint64_t(edge_telemetry.session_start_us + ring_offset_us)
+                                  * sim::CYCLES_PER_US + 37;
+            sim::schedule_core0(ring_cycle, []{send_core1_abort();});
+            for (size_t i = 0; !update_abort_state() && (i < 1000); ++i)
+                run_sequence();
+            CHECK(!enabled);
+            CHECK(active_schedule_backend == backend);
+            CHECK(frame_count <= 1);
+            const auto& trace = sim::trace();
+            CHECK(!trace.empty());
+            if (trace.empty())
+                continue;
+            // Nothing rises after the ring, and everything is LOW within the
+            // bound.
+            CHECK(trace.back().state() == 0);
+            uint32_t state_at_ring = 0;
+            for (auto& sample: trace)
+            {
+                if (sample.cycle <= ring_cycle)
+                    state_at_ring = sample.state();
+                else
+                    CHECK((sample.state() & ~state_at_ring) == 0);
+            }
+            if (ring_offset_us < 3 * task_period_us - DELTA2)
+                CHECK(state_at_ring != 0);
+            CHECK(std::max(trace.back().cycle, ring_cycle) - ring_cycle
+                  <= MAX_ABORT_LATENCY_US * sim::CYCLES_PER_US);
+            // Nothing is left to answer, and the schedule restarts as usual.
+            update_commands();
+            CHECK(core1_commands_applied());
+            CHECK(!hal_doorbell_rung());
+            drain_events();
+            load_tasks(default_fip_tasks());
+            while (frame_count < 1)
+                run_sequence();
+            stop_sequence();
+            CHECK(sim::rising_edges(IO_PIN(LASER_565)).size() == 1);
+        }
+    }
+}
+
+void test_idle_wakeup()
+{
+    // Wake-up plus start-up time from core0 enabling the schedule to the
+    // first laser edge.
+    constexpr uint64_t MAX_WAKE_LATENCY_US = 5;
+    for (uint8_t backend: {CPU_BACKEND, PIO_BACKEND, TIMER_IRQ_BACKEND})
+    {
+        reset_fixture();
+        {
+            sim::Core0Scope core0;
+            send_core1_command(Core1Command::backend(backend));
+        }
+        run_once();
+        // A disabled core1 sleeps until core0 changes something, and applies
+        // tables published while it slept.
+        uint64_t publish_cycle = sim::now_cycles() + 1000 * sim::CYCLES_PER_US;
+        sim::schedule_core0(publish_cycle, []{publish_tasks(default_fip_tasks());});
+        run_once();
+        CHECK(sim::now_cycles() - publish_cycle == sim::costs().irq_entry);
+        CHECK(task_table_swap.is_pending());
+        run_once();
+        CHECK(!task_table_swap.is_pending());
+        CHECK(fip_task_count == 3);
+        CHECK(!enabled);
+
+        uint64_t enable_cycle = sim::now_cycles() + 1000 * sim::CYCLES_PER_US;
+        sim::schedule_core0(enable_cycle, []
+        {
+            send_core1_command(Core1Command::enable(true));
+        });
+        sim::clear_trace();
+        run_once();
+        CHECK(sim::now_cycles() - enable_cycle == sim::costs().irq_entry);
+        CHECK(sim::trace().empty());
+        run_once();
+        CHECK(enabled);
+        CHECK(active_schedule_backend == backend);
+        stop_sequence();
+        auto rises_470 = sim::rising_edges(IO_PIN(LASER_470));
+        CHECK(rises_470.size() == 1);
+        if (rises_470.empty())
+            continue;
+        CHECK(rises_470[0] - enable_cycle <= MAX_WAKE_LATENCY_US * sim::CYCLES_PER_US);
+        drain_events();
+    }
+}
+
+int main()
+{
+    test_timeline_flattens_tasks();
+    test_single_exposure_edges();
+    test_sequence_runs_tasks_in_order();
+    test_events_match_edges();
+    test_mute_keeps_timing_but_not_outputs();
+    test_commands_control_state();
+    test_remove_and_clear_tasks();
+    test_stable_task_slots();
+    test_frames_do_not_drift();
+    test_edge_telemetry();
+    test_pio_edge_table_timing();
+    test_pio_backend();
+    test_timer_irq_backend();
+    test_spsc_ring();
+    test_event_batch();
+    test_event_subscriptions();
+    test_hot_reconfiguration();
+    test_task_table_swap_changes_task_count();
+    test_full_task_table();
+    test_pwm_config();
+    test_reconfigure_touches_changed_hardware();
+    test_schedule_check();
+    test_fixed_frame_period();
+    test_frame_divisors();
+    test_pipelined_exposures();
+    test_finite_acquisition();
+    test_scheduled_start();
+    test_external_trigger();
+    test_empty_frames();
+    test_abort_latency();
+    test_idle_wakeup();
+    if (failures)
+        printf("%d check(s) failed.\r\n", failures);
+    else
+        printf("All checks passed.\r\n");
+    return failures ? 1 : 0;
+}
@@ -1,19 +1,35 @@
 #include <pico/stdlib.h>
 #include <cstdio>
 #include <cstdint>
+#include <hardware/clocks.h>
 #include <fip_schedule.h>
+#include <fip_ctrl_queues.h>
 
 inline constexpr uint32_t LED_PIN = 25;
 
+queue_t core1_command_queue;
+RisingEdgeEventRing rising_edge_event_ring;
+AcquisitionEndRing acquisition_end_ring;
+TaskTableSwap task_table_swap;
+
 
 int main()
 {
-    setup_fip_schedule();
 //    stdio_usb_init();
 //    stdio_set_translate_crlf(&stdio_usb, false); // Don't replace outgoing chars.
 //    while (!stdio_usb_connected()){} // Block until connection to serial port.
 //    printf("Hello, world!\r\n");
+    queue_init(&core1_command_queue, sizeof(Core1Command), CORE1_COMMAND_QUEUE_SIZE);
+
+    // One 470nm exposure of the green camera per frame, without events. The
+    // scheduler runs on this core, so core0's part is done before it starts.
+    TaskTable table{};
+    size_t slot = add_task_slot(table);
+    table.tasks[slot] = {1u << PWM_470_PIN, 1.0f, 10000.f, 1u << CAM_G_PIN, 0, 0,
+                         DELTA1, DELTA2, DELTA3, DELTA4};
+    table.pwm[slot] = LaserPWMConfig::resolve(1.0f, 10000.f, clock_get_hz(clk_sys));
+    task_table_swap.try_publish(table);
+    send_core1_command(Core1Command::enable(true));
 
-    while(true)
-        run();
+    run();
 }
@@ -1,5 +1,5 @@
 """App registers for the cuttlefish-fip controller."""
-from enum import IntEnum
+from enum import IntEnum, IntFlag
 
 
 class AppRegs(IntEnum):
@@ -18,3 +18,49 @@ class AppRegs(IntEnum):
     ReconfigureLaserTask5 = 43
     ReconfigureLaserTask6 = 44
     ReconfigureLaserTask7 = 45
+
+    EdgeCount = 46
+    EdgeDeadlineMissCount = 47
+    EdgeLatenessMin = 48
+    EdgeLatenessMax = 49
+    EdgeLatenessMeanNs = 50
+    EdgeLatenessHistogram = 51
+
+    ScheduleBackend = 52
+    ActiveScheduleBackend = 53
+    RisingEdgeEventOverflowCount = 54
+    RisingEdgeEventHighWaterMark = 55
+    RisingEdgeEventBatchSize = 56
+    RisingEdgeEventBatch = 57
+    TaskSettingsAppliedFrame = 58
+    LaserTaskTable = 59
+    PredictedFramePeriod = 60
+    PredictedFrameRate = 61
+    PredictedLaserDutyCycle = 62
+    TaskScheduleError = 63
+    FixedFramePeriod = 64
+    FramePeriodSlack = 65
+    TaskFrameDivisors = 66
+    PipelinedExposures = 67
+    AcquisitionFrameCount = 68
+    AcquisitionComplete = 69
+    ScheduledStartTime = 70
+    TriggerMode = 71
+    TriggerPin = 72
+    TriggerLatency = 73
+    LaserTaskOrder = 74
+    PendingCommandCount = 75
+
+
+class TaskEvents(IntFlag):
+    """Events byte of the task settings: which edges emit a RisingEdgeEvent.
+
+    ENABLED on its own selects LASER_ON and CAMERA_ON. If any other flag is
+    set, exactly the flagged edges emit events.
+    """
+    NONE = 0x0
+    ENABLED = 0x1
+    LASER_ON = 0x2
+    CAMERA_ON = 0x4
+    CAMERA_OFF = 0x8
+    LASER_OFF = 0x10